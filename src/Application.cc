@@ -21,8 +21,12 @@
 
 #include <SDL2/SDL.h>
 
+#include "Constants.hh"
 #include "Scene.hh"
 
+// total size of cached assets not used by any scene
+static const size_t kAssetCacheBudget = 256 * 1024 * 1024;
+
 bool Application::CheckFlags() {
 	if (must_exit_)
 		return false;
@@ -36,23 +40,57 @@ bool Application::CheckFlags() {
 }
 
 void Application::MainLoop() {
+	const Uint64 tick_length = SDL_GetPerformanceFrequency() / kTicksPerSecond;
+
+	Uint64 prev_time = SDL_GetPerformanceCounter();
+	Uint64 accumulated_time = 0;
+
 	while (1) {
 		// Process events
-		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
-			current_scene_->ProcessEvent(event);
+		{
+			Profiler::ScopedTimer timer(profiler_, Profiler::EVENTS);
+
+			SDL_Event event;
+			while (SDL_PollEvent(&event)) {
+				current_scene_->ProcessEvent(event);
+				if (!CheckFlags())
+					return;
+			}
+		}
+
+		// Update scene logic in fixed ticks
+		Uint64 time = SDL_GetPerformanceCounter();
+		accumulated_time += time - prev_time;
+		prev_time = time;
+
+		for (int tick = 0; accumulated_time >= tick_length; tick++) {
+			if (tick == kMaxTicksPerFrame) {
+				// drop time we can't catch up with
+				accumulated_time %= tick_length;
+				break;
+			}
+
+			{
+				Profiler::ScopedTimer timer(profiler_, Profiler::UPDATE);
+				current_scene_->Update(kTickDuration);
+			}
 			if (!CheckFlags())
 				return;
+
+			accumulated_time -= tick_length;
 		}
 
-		// Update scene logic
-		current_scene_->Update();
-		if (!CheckFlags())
-			return;
+		// Render, interpolating between last two ticks
+		{
+			Profiler::ScopedTimer timer(profiler_, Profiler::RENDER);
+			current_scene_->Render((float)accumulated_time / tick_length);
+		}
+		{
+			Profiler::ScopedTimer timer(profiler_, Profiler::PRESENT);
+			renderer_.Present();
+		}
 
-		// Render
-		current_scene_->Render();
-		renderer_.Present();
+		profiler_.EndFrame();
 
 		// Frame limiter
 		SDL_Delay(1);
@@ -62,6 +100,11 @@ void Application::MainLoop() {
 Application::Application(const std::string& title) :
 	sdl_(SDL_INIT_VIDEO),
 	window_(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, SDL_WINDOW_RESIZABLE),
-	renderer_(window_, -1, SDL_RENDERER_ACCELERATED),
+	renderer_(window_, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE),
+	asset_cache_(renderer_, kAssetCacheBudget),
 	must_exit_(false) {
 }
+
+void Application::SetProfilePath(const std::string& path) {
+	profile_path_ = path;
+}
@@ -28,6 +28,9 @@
 #include <SDL2pp/Renderer.hh>
 #include <SDL2pp/Texture.hh>
 
+#include "AssetCache.hh"
+#include "Profiler.hh"
+
 class Scene;
 
 class Application {
@@ -37,10 +40,16 @@ private:
 	SDL2pp::Window window_;
 	SDL2pp::Renderer renderer_;
 
+	// outlives scenes, so assets are shared between them
+	AssetCache asset_cache_;
+
 	std::unique_ptr<Scene> current_scene_;
 	std::unique_ptr<Scene> next_scene_;
 	bool must_exit_;
 
+	Profiler profiler_;
+	std::string profile_path_;
+
 private:
 	bool CheckFlags();
 	void MainLoop();
@@ -48,10 +57,16 @@ private:
 public:
 	Application(const std::string& title);
 
+	// Save profiling data to given file on exit, see Profiler::Save
+	void SetProfilePath(const std::string& path);
+
 	template<class NewScene, class... Args>
 	void Run(Args&&... args) {
 		current_scene_.reset(new NewScene(*this, std::forward<Args>(args)...));
 		MainLoop();
+
+		if (!profile_path_.empty())
+			profiler_.Save(profile_path_);
 	}
 };
 
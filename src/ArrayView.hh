@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARRAYVIEW_HH
+#define ARRAYVIEW_HH
+
+#include <cstddef>
+
+// Non-owning view of a contiguous array
+template <class T>
+class ArrayView {
+private:
+	const T* begin_ = nullptr;
+	const T* end_ = nullptr;
+
+public:
+	ArrayView() {
+	}
+
+	ArrayView(const T* data, size_t size)
+		: begin_(data),
+		  end_(data + size) {
+	}
+
+	const T* begin() const {
+		return begin_;
+	}
+
+	const T* end() const {
+		return end_;
+	}
+
+	const T* data() const {
+		return begin_;
+	}
+
+	size_t size() const {
+		return end_ - begin_;
+	}
+
+	bool empty() const {
+		return begin_ == end_;
+	}
+
+	const T& operator[](size_t index) const {
+		return begin_[index];
+	}
+};
+
+#endif // ARRAYVIEW_HH
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AssetCache.hh"
+
+#include <sys/stat.h>
+
+#include <SDL2pp/Surface.hh>
+
+#include "LowresPainter.hh"
+
+AssetCache::AssetCache(SDL2pp::Renderer& renderer, size_t budget)
+	: renderer_(renderer),
+	  budget_(budget) {
+}
+
+template <class T, class Validator>
+std::shared_ptr<T> AssetCache::Find(const std::string& key, Validator valid) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto entry = entries_.find(key);
+	if (entry == entries_.end())
+		return nullptr;
+
+	if (!valid(entry->second)) {
+		total_size_ -= entry->second.size;
+		entries_.erase(entry);
+		return nullptr;
+	}
+
+	entry->second.last_use = ++use_counter_;
+	return std::static_pointer_cast<T>(entry->second.asset);
+}
+
+void AssetCache::Insert(const std::string& key, Entry&& entry) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// if the same asset was loaded concurrently, the last one
+	// loaded is kept
+	Entry& slot = entries_[key];
+	total_size_ -= slot.size;
+
+	slot = std::move(entry);
+	slot.last_use = ++use_counter_;
+
+	total_size_ += slot.size;
+
+	Trim();
+}
+
+template <class T, class Loader>
+std::shared_ptr<T> AssetCache::Get(const std::string& key, const std::string& path, Loader loader) {
+	// missing file is left for the loader to complain about
+	struct stat st;
+	const bool have_stat = stat(path.c_str(), &st) == 0;
+
+	std::shared_ptr<T> asset = Find<T>(key, [have_stat, &st](const Entry& entry) {
+			return have_stat && entry.mtime == st.st_mtime && entry.file_size == st.st_size;
+		});
+	if (asset)
+		return asset;
+
+	// loading is done unlocked, so slow loads don't block other
+	// threads
+	Entry entry;
+	entry.size = 0;
+	asset = loader(entry.size);
+
+	entry.asset = asset;
+	entry.mtime = have_stat ? st.st_mtime : 0;
+	entry.file_size = have_stat ? st.st_size : 0;
+
+	Insert(key, std::move(entry));
+
+	return asset;
+}
+
+void AssetCache::Trim() {
+	while (total_size_ > budget_) {
+		auto victim = entries_.end();
+		for (auto entry = entries_.begin(); entry != entries_.end(); ++entry)
+			if (entry->second.asset.use_count() == 1 && (victim == entries_.end() || entry->second.last_use < victim->second.last_use))
+				victim = entry;
+
+		// everything left is in use
+		if (victim == entries_.end())
+			return;
+
+		total_size_ -= victim->second.size;
+		entries_.erase(victim);
+	}
+}
+
+std::shared_ptr<const GameMap> AssetCache::GetMap(const std::string& path) {
+	return Get<GameMap>("map:" + path, path, [&path](size_t& size) {
+			std::shared_ptr<GameMap> map = std::make_shared<GameMap>(path);
+			size = map->GetDataSize();
+			return map;
+		});
+}
+
+std::shared_ptr<const SoftwareRasterizer> AssetCache::GetAtlas(const std::string& path) {
+	return Get<SoftwareRasterizer>("atlas:" + path, path, [&path](size_t& size) {
+			std::shared_ptr<SoftwareRasterizer> atlas = std::make_shared<SoftwareRasterizer>(LowresPainter::BuildAtlas(SDL2pp::Surface(path)));
+			size = atlas->GetHeight() * atlas->GetPitch();
+			return atlas;
+		});
+}
+
+std::shared_ptr<SDL2pp::Texture> AssetCache::GetAtlasTexture(const std::string& path, const std::shared_ptr<const SoftwareRasterizer>& atlas) {
+	const std::string key = "texture:" + path;
+
+	// file is not checked, so texture always matches given atlas
+	// even if the file has changed since the atlas was loaded
+	std::shared_ptr<SDL2pp::Texture> texture = Find<SDL2pp::Texture>(key, [&atlas](const Entry& entry) {
+			return entry.source == atlas;
+		});
+	if (texture)
+		return texture;
+
+	texture = std::make_shared<SDL2pp::Texture>(LowresPainter::CreateAtlasTexture(renderer_, *atlas));
+
+	Entry entry;
+	entry.asset = texture;
+	entry.source = atlas;
+	entry.size = atlas->GetHeight() * atlas->GetPitch();
+	entry.mtime = 0;
+	entry.file_size = 0;
+
+	Insert(key, std::move(entry));
+
+	return texture;
+}
+
+void AssetCache::Invalidate(const std::string& path) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// keys are kind and path separated by colon
+	for (auto entry = entries_.begin(); entry != entries_.end(); ) {
+		if (entry->first.compare(entry->first.find(':') + 1, std::string::npos, path) == 0) {
+			total_size_ -= entry->second.size;
+			entry = entries_.erase(entry);
+		} else {
+			++entry;
+		}
+	}
+}
+
+size_t AssetCache::GetTotalSize() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return total_size_;
+}
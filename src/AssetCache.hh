@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASSETCACHE_HH
+#define ASSETCACHE_HH
+
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <SDL2pp/Renderer.hh>
+#include <SDL2pp/Texture.hh>
+
+#include "GameMap.hh"
+#include "SoftwareRasterizer.hh"
+
+// Assets shared between scenes, keyed by file path
+//
+// Handles are shared pointers, so an asset stays alive while any
+// scene uses it, and a scene created later gets the same asset
+// without loading it again. Before an asset is handed out, its
+// file's modification time is checked, and a changed file is
+// reloaded (holders of old handles keep the old asset); textures
+// are tied to the atlas they are made from instead. When total
+// size of assets exceeds the budget, least recently used ones not
+// held by anyone are evicted.
+//
+// Maps and atlases may be requested from any thread; textures
+// only from the render thread.
+class AssetCache {
+private:
+	struct Entry {
+		std::shared_ptr<void> asset;
+		std::shared_ptr<const void> source; // asset this one is made from
+		size_t size;
+		time_t mtime;
+		off_t file_size;
+		unsigned long last_use = 0;
+	};
+
+private:
+	SDL2pp::Renderer& renderer_;
+	const size_t budget_;
+
+	std::mutex mutex_;
+	std::map<std::string, Entry> entries_;
+	size_t total_size_ = 0;
+	unsigned long use_counter_ = 0;
+
+private:
+	// Returns cached asset, if any, as long as valid(entry) holds;
+	// otherwise the entry is dropped
+	template <class T, class Validator>
+	std::shared_ptr<T> Find(const std::string& key, Validator valid);
+	void Insert(const std::string& key, Entry&& entry);
+
+	template <class T, class Loader>
+	std::shared_ptr<T> Get(const std::string& key, const std::string& path, Loader loader);
+
+	void Trim();
+
+public:
+	// Budget is in bytes
+	AssetCache(SDL2pp::Renderer& renderer, size_t budget);
+
+	AssetCache(const AssetCache&) = delete;
+	AssetCache& operator=(const AssetCache&) = delete;
+
+	// Metatile table is a part of the map
+	std::shared_ptr<const GameMap> GetMap(const std::string& path);
+
+	// Tiles atlas with flipped variants, see LowresPainter::BuildAtlas
+	std::shared_ptr<const SoftwareRasterizer> GetAtlas(const std::string& path);
+
+	// Texture made from given atlas, which was loaded from path
+	std::shared_ptr<SDL2pp::Texture> GetAtlasTexture(const std::string& path, const std::shared_ptr<const SoftwareRasterizer>& atlas);
+
+	// Forces assets loaded from given file to be reloaded on next
+	// request, for changes not visible in modification time
+	void Invalidate(const std::string& path);
+
+	size_t GetTotalSize();
+};
+
+#endif // ASSETCACHE_HH
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AssetLoader.hh"
+
+static const int kNumSteps = 2;
+
+AssetLoader::AssetLoader(AssetCache& cache, const std::string& map_path, const std::string& tiles_path)
+	: cache_(cache),
+	  steps_done_(0),
+	  done_(false),
+	  thread_(&AssetLoader::Load, this, map_path, tiles_path) {
+}
+
+AssetLoader::~AssetLoader() {
+	// loading can't be interrupted, so exiting during loading
+	// waits for it to finish
+	if (thread_.joinable())
+		thread_.join();
+}
+
+void AssetLoader::Load(const std::string& map_path, const std::string& tiles_path) {
+	assets_.map_path = map_path;
+	assets_.tiles_path = tiles_path;
+
+	try {
+		assets_.atlas = cache_.GetAtlas(tiles_path);
+		steps_done_++;
+
+		assets_.map = cache_.GetMap(map_path);
+		steps_done_++;
+	} catch (...) {
+		error_ = std::current_exception();
+	}
+
+	done_ = true;
+}
+
+float AssetLoader::GetProgress() const {
+	return (float)steps_done_ / kNumSteps;
+}
+
+bool AssetLoader::IsDone() const {
+	return done_;
+}
+
+AssetLoader::Assets AssetLoader::Take() {
+	if (thread_.joinable())
+		thread_.join();
+
+	if (error_)
+		std::rethrow_exception(error_);
+
+	assets_.atlas_texture = cache_.GetAtlasTexture(assets_.tiles_path, assets_.atlas);
+
+	return std::move(assets_);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASSETLOADER_HH
+#define ASSETLOADER_HH
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <SDL2pp/Texture.hh>
+
+#include "AssetCache.hh"
+#include "GameMap.hh"
+#include "SoftwareRasterizer.hh"
+
+// Loads game assets on a background thread
+//
+// Everything which doesn't need the renderer (decoding the image,
+// building atlas variants, parsing the map) is done by the loader
+// thread, so the render thread only has to upload textures once
+// assets are taken. Assets are obtained through the cache, so
+// ones already loaded by earlier scenes are reused.
+class AssetLoader {
+public:
+	struct Assets {
+		std::shared_ptr<const GameMap> map;
+		std::shared_ptr<const SoftwareRasterizer> atlas; // see LowresPainter::BuildAtlas
+		std::shared_ptr<SDL2pp::Texture> atlas_texture;
+
+		// where assets came from, for reloading
+		std::string map_path;
+		std::string tiles_path;
+	};
+
+private:
+	AssetCache& cache_;
+
+	Assets assets_;
+	std::exception_ptr error_;
+
+	std::atomic<int> steps_done_;
+	std::atomic<bool> done_;
+
+	std::thread thread_;
+
+private:
+	void Load(const std::string& map_path, const std::string& tiles_path);
+
+public:
+	AssetLoader(AssetCache& cache, const std::string& map_path, const std::string& tiles_path);
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// Fraction of loading done, 0 to 1
+	float GetProgress() const;
+
+	bool IsDone() const;
+
+	// Waits for loading to finish; rethrows loading error, if any.
+	// Must be called from the render thread, as it creates textures
+	Assets Take();
+};
+
+#endif // ASSETLOADER_HH
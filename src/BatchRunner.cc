@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BatchRunner.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "Constants.hh"
+#include "GameMap.hh"
+#include "GameWorld.hh"
+#include "InputTrace.hh"
+
+BatchRunner::BatchRunner(const GameMap& map, unsigned int num_threads)
+	: map_(map),
+	  num_threads_(num_threads) {
+	if (num_threads_ == 0)
+		num_threads_ = std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+unsigned int BatchRunner::GetNumThreads() const {
+	return num_threads_;
+}
+
+std::vector<BatchRunner::Result> BatchRunner::Run(const std::vector<const InputTrace*>& traces) const {
+	std::vector<Result> results(traces.size());
+
+	// workers pick simulations one by one until none are left,
+	// so uneven trace lengths are balanced automatically
+	std::atomic<size_t> next_trace(0);
+
+	std::mutex error_mutex;
+	std::exception_ptr error;
+
+	auto worker = [&]() {
+		size_t n;
+		while ((n = next_trace++) < traces.size()) {
+			try {
+				results[n] = RunSingle(map_, *traces[n]);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < std::min<size_t>(num_threads_, traces.size()); i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	if (error)
+		std::rethrow_exception(error);
+
+	return results;
+}
+
+BatchRunner::Result BatchRunner::RunSingle(const GameMap& map, const InputTrace& trace) {
+	GameWorld world(map);
+	Result result;
+
+	for (const auto& run : trace.GetRuns()) {
+		world.SetControlFlags(run.flags);
+		for (unsigned int tick = 0; tick < run.ticks && !world.IsDead(); tick++) {
+			world.Update(kTickDuration);
+			result.ticks++;
+
+			if (trace.IsHashTick(result.ticks)) {
+				const uint64_t hash = world.GetStateHash();
+				if (result.divergence_tick == 0 && !trace.CheckHash(result.ticks, hash))
+					result.divergence_tick = result.ticks;
+				result.hashes.push_back(hash);
+			}
+		}
+	}
+
+	// simulation which ended before recorded one did diverged too
+	if (result.divergence_tick == 0 && result.hashes.size() < trace.GetHashes().size())
+		result.divergence_tick = result.ticks;
+
+	result.x = world.GetPlayer().GetX();
+	result.y = world.GetPlayer().GetY();
+	result.dead = world.IsDead();
+	result.death_reason = world.GetDeathReason();
+
+	return result;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCHRUNNER_HH
+#define BATCHRUNNER_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class GameMap;
+class InputTrace;
+
+// Runs independent headless simulations in parallel
+//
+// Each simulation gets its own GameWorld driven by its own input
+// trace, while all of them share single immutable GameMap
+class BatchRunner {
+public:
+	struct Result {
+		unsigned long ticks = 0;
+		float x = 0.0f;
+		float y = 0.0f;
+		bool dead = false;
+		std::string death_reason;
+
+		// state hashes taken at trace's hash interval
+		std::vector<uint64_t> hashes;
+
+		// first tick at which state hash didn't match one stored
+		// in the trace, or zero
+		unsigned long divergence_tick = 0;
+	};
+
+private:
+	const GameMap& map_;
+	unsigned int num_threads_;
+
+public:
+	// Zero number of threads means number of CPU cores
+	BatchRunner(const GameMap& map, unsigned int num_threads = 0);
+
+	unsigned int GetNumThreads() const;
+
+	// Results are in the same order as traces
+	std::vector<Result> Run(const std::vector<const InputTrace*>& traces) const;
+
+	static Result RunSingle(const GameMap& map, const InputTrace& trace);
+};
+
+#endif // BATCHRUNNER_HH
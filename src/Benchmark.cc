@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "Constants.hh"
+#include "GameMap.hh"
+#include "GameWorld.hh"
+#include "MapCompiler.hh"
+#include "ObjectPool.hh"
+#include "Physics.hh"
+#include "SnapshotRing.hh"
+#include "SoftwareRasterizer.hh"
+
+// Performance benchmarks for game subsystems
+
+namespace {
+
+constexpr double kMinBenchmarkTime = 0.5; // seconds
+
+struct Result {
+	std::string name;
+	unsigned long iterations;
+	double ns_per_op;
+};
+
+std::vector<Result> results;
+std::string filter;
+
+// Whether any benchmark with name starting with prefix may
+// pass the filter; used to skip costly preparations
+bool Enabled(const std::string& prefix) {
+	return prefix.compare(0, filter.size(), filter) == 0 || filter.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Runs func repeatedly for at least kMinBenchmarkTime and records
+// mean time per operation, func doing ops operations per call.
+// Benchmarks with names not starting with filter are skipped
+template <class Func>
+void Benchmark(const std::string& name, unsigned long ops, Func func) {
+	typedef std::chrono::steady_clock clock;
+
+	if (name.compare(0, filter.size(), filter) != 0)
+		return;
+
+	unsigned long iterations = 0;
+	std::chrono::duration<double> elapsed(0);
+
+	auto start_time = clock::now();
+	do {
+		func();
+		iterations++;
+		elapsed = clock::now() - start_time;
+	} while (elapsed.count() < kMinBenchmarkTime);
+
+	results.push_back(Result{name, iterations, elapsed.count() * 1.0e9 / iterations / ops});
+
+	std::cerr << name << "\t" << iterations << "\t" << results.back().ns_per_op << " ns/op" << std::endl;
+}
+
+// Prevents compiler from optimizing out computations
+volatile unsigned int sink;
+
+std::string Base64Encode(const std::vector<unsigned char>& data) {
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::string result;
+	result.reserve((data.size() + 2) / 3 * 4);
+
+	for (size_t i = 0; i < data.size(); i += 3) {
+		uint32_t chunk = data[i] << 16;
+		if (i + 1 < data.size())
+			chunk |= data[i + 1] << 8;
+		if (i + 2 < data.size())
+			chunk |= data[i + 2];
+
+		result += alphabet[(chunk >> 18) & 0x3f];
+		result += alphabet[(chunk >> 12) & 0x3f];
+		result += i + 1 < data.size() ? alphabet[(chunk >> 6) & 0x3f] : '=';
+		result += i + 2 < data.size() ? alphabet[chunk & 0x3f] : '=';
+	}
+
+	return result;
+}
+
+std::vector<unsigned char> Compress(const std::vector<unsigned char>& data, bool gzip) {
+	z_stream stream;
+	std::memset(&stream, 0, sizeof(stream));
+
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw std::runtime_error("cannot initialize compression");
+
+	std::vector<unsigned char> result(deflateBound(&stream, data.size()));
+
+	stream.next_in = const_cast<unsigned char*>(data.data());
+	stream.avail_in = data.size();
+	stream.next_out = result.data();
+	stream.avail_out = result.size();
+
+	if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+		deflateEnd(&stream);
+		throw std::runtime_error("cannot compress data");
+	}
+
+	result.resize(stream.total_out);
+	deflateEnd(&stream);
+
+	return result;
+}
+
+// Generates .tmx map with random tiles in given layer encoding
+std::string GenerateMap(int width, int height, const std::string& encoding, const std::string& compression) {
+	std::mt19937 rng(width * height);
+
+	// random runs of tiles, compressible similar to real maps
+	std::vector<uint32_t> tiles(width * height);
+	uint32_t tile = 0;
+	for (auto& cell : tiles) {
+		if (rng() % 8 == 0)
+			tile = (rng() % 256) | (rng() % 8 == 0 ? (rng() % 8) << 29 : 0);
+		cell = tile;
+	}
+
+	std::ostringstream tmx;
+	tmx << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	    << "<map version=\"1.0\" orientation=\"orthogonal\" width=\"" << width << "\" height=\"" << height << "\" tilewidth=\"16\" tileheight=\"16\">\n"
+	    << " <tileset firstgid=\"1\" name=\"Tiles\" tilewidth=\"16\" tileheight=\"16\">\n"
+	    << "  <image source=\"../images/tiles.png\" width=\"256\" height=\"256\"/>\n"
+	    << "  <tile id=\"1\"><objectgroup><object x=\"0\" y=\"0\" width=\"16\" height=\"16\"/></objectgroup></tile>\n"
+	    << "  <tile id=\"3\"><objectgroup><object x=\"1\" y=\"10\" width=\"14\" height=\"6\"/><object x=\"4\" y=\"2\" width=\"8\" height=\"8\"/></objectgroup></tile>\n"
+	    << " </tileset>\n"
+	    << " <layer name=\"Ground\" width=\"" << width << "\" height=\"" << height << "\">\n"
+	    << "  <data encoding=\"" << encoding << "\"";
+
+	if (!compression.empty())
+		tmx << " compression=\"" << compression << "\"";
+	tmx << ">\n";
+
+	if (encoding == "csv") {
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++)
+				tmx << tiles[y * width + x] << ",";
+			tmx << "\n";
+		}
+	} else {
+		std::vector<unsigned char> bytes;
+		bytes.reserve(tiles.size() * 4);
+		for (auto tile : tiles)
+			for (int byte = 0; byte < 4; byte++)
+				bytes.push_back((tile >> (byte * 8)) & 0xff);
+
+		if (!compression.empty())
+			bytes = Compress(bytes, compression == "gzip");
+
+		tmx << Base64Encode(bytes) << "\n";
+	}
+
+	tmx << "  </data>\n"
+	    << " </layer>\n"
+	    << " <objectgroup name=\"Objects\">\n"
+	    << "  <object type=\"player_start\" x=\"16\" y=\"16\" width=\"16\" height=\"16\"/>\n"
+	    << " </objectgroup>\n"
+	    << "</map>\n";
+
+	return tmx.str();
+}
+
+void BenchmarkMapLoading() {
+	struct Format {
+		const char* encoding;
+		const char* compression;
+	};
+
+	static const Format formats[] = {
+		{ "csv", "" },
+		{ "base64", "" },
+		{ "base64", "zlib" },
+		{ "base64", "gzip" },
+	};
+
+	Benchmark("map_load/planetonomy.tmx", 1, []() {
+			GameMap map(DATADIR "/maps/planetonomy.tmx");
+		});
+
+	for (int size : { 256, 1024, 4096 }) {
+		for (const auto& format : formats) {
+			std::ostringstream name;
+			name << "map_load/" << size << "x" << size << "/" << format.encoding;
+			if (*format.compression)
+				name << "+" << format.compression;
+
+			if (!Enabled(name.str()))
+				continue;
+
+			// uncompressed huge maps take too much time and memory
+			// to generate, and are not really practical
+			if (size > 1024 && !*format.compression)
+				continue;
+
+			const std::string tmx = GenerateMap(size, size, format.encoding, format.compression);
+
+			Benchmark(name.str(), 1, [&tmx]() {
+					GameMap map(MapCompiler(tmx.data(), tmx.size()).GetBlob());
+				});
+		}
+	}
+}
+
+void BenchmarkGetTile() {
+	static const unsigned long kLookups = 1 << 20;
+
+	for (int size : { 1024, 4096 }) {
+		std::ostringstream prefix;
+		prefix << "get_tile/" << size << "x" << size << "/";
+
+		if (!Enabled(prefix.str()))
+			continue;
+
+		const std::string tmx = GenerateMap(size, size, "base64", "zlib");
+		const GameMap map(MapCompiler(tmx.data(), tmx.size()).GetBlob());
+
+		Benchmark(prefix.str() + "sequential", (unsigned long)size * size, [&map, size]() {
+				unsigned int sum = 0;
+				for (int y = 0; y < size; y++)
+					for (int x = 0; x < size; x++)
+						sum += map.GetTile(x, y).GetType();
+				sink = sum;
+			});
+
+		std::mt19937 rng(1);
+		std::vector<SDL2pp::Point> points(kLookups);
+		for (auto& point : points)
+			point = SDL2pp::Point(rng() % size, rng() % size);
+
+		Benchmark(prefix.str() + "random", kLookups, [&map, &points]() {
+				unsigned int sum = 0;
+				for (const auto& point : points)
+					sum += map.GetTile(point.x, point.y).GetType();
+				sink = sum;
+			});
+	}
+}
+
+void BenchmarkCollision() {
+	static const int kCases = 4096;
+
+	if (!Enabled("collision/"))
+		return;
+
+	const GameMap map(DATADIR "/maps/planetonomy.tmx");
+	const GameWorld world(map);
+
+	const int map_width = map.GetWidth() * kTileSize;
+	const int map_height = map.GetHeight() * kTileSize;
+
+	std::mt19937 rng(1);
+
+	std::vector<SDL2pp::Rect> rects(kCases);
+	for (auto& rect : rects)
+		rect = SDL2pp::Rect(rng() % map_width, rng() % map_height, 1 + rng() % 32, 1 + rng() % 32);
+
+	Benchmark("collision/check_static", kCases, [&world, &rects]() {
+			unsigned int sum = 0;
+			for (const auto& rect : rects)
+				sum += world.CheckCollisionWithStatic(rect);
+			sink = sum;
+		});
+
+	// random placements and velocities of the player, including
+	// fast ones which take many sub-steps
+	ObjectPool objects;
+	const unsigned int player = objects.AddMetaTile(map.GetMetaTileInfo("player"));
+	for (int i = 0; i < kCases; i++) {
+		const ObjectPool::Index index = objects.Add(player, SDL2pp::Rect(rng() % map_width, rng() % map_height, 0, 0), 1.0f);
+		objects.xvel[index] = (float)(rng() % 801) - 400.0f;
+		objects.yvel[index] = (float)(rng() % 801) - 400.0f;
+	}
+
+	// every run starts from the same state
+	ObjectPool moving;
+
+	Benchmark("collision/move", kCases, [&world, &objects, &moving]() {
+			moving = objects;
+			unsigned int sum = 0;
+			for (ObjectPool::Index index = 0; index < moving.GetSize(); index++)
+				sum += world.MoveWithCollision(moving, index, kTickDuration);
+			sink = sum;
+		});
+
+	Benchmark("collision/gravity", kCases, [&moving]() {
+			moving.ApplyGravity(kGForce * kTickDuration);
+			sink = (unsigned int)moving.yvel[0];
+		});
+}
+
+void BenchmarkRendering() {
+	static const int kScreens = 64;
+
+	if (!Enabled("render_ground/"))
+		return;
+
+	const std::string tmx = GenerateMap(1024, 1024, "base64", "zlib");
+	const GameMap map(MapCompiler(tmx.data(), tmx.size()).GetBlob());
+
+	// contents of atlas don't matter, but transparency does
+	std::mt19937 rng(1);
+	std::vector<uint32_t> atlas(256 * 256);
+	for (auto& pixel : atlas)
+		pixel = rng() % 4 == 0 ? 0 : rng() | 0xff000000;
+
+	SoftwareRasterizer rasterizer(kScreenWidthPixels, kScreenHeightPixels);
+	rasterizer.SetAtlas(atlas.data(), 256, 256, 256 * sizeof(uint32_t));
+
+	std::vector<SDL2pp::Point> offsets(kScreens);
+	for (auto& offset : offsets)
+		offset = SDL2pp::Point(rng() % (1024 / kScreenWidthTiles) * kScreenWidthTiles, rng() % (1024 / kScreenHeightTiles - 1) * kScreenHeightTiles);
+
+	// same as GameScene::RenderGroundTiles, with software backend
+	Benchmark("render_ground/software", kScreens, [&map, &rasterizer, &offsets]() {
+			for (const auto& offset : offsets) {
+				rasterizer.Clear(0xff000000);
+				for (int y = 0; y < (kScreenHeightPixels + kTileSize - 1) / kTileSize; y++) {
+					for (int x = 0; x < kScreenWidthTiles; x++) {
+						GameMap::Tile tt = map.GetTile(offset.x + x, offset.y + y);
+						if (tt.GetType() != 0)
+							rasterizer.Blit(tt.GetSourceRect(), SDL2pp::Point(x * kTileSize, y * kTileSize), tt.GetFlips());
+					}
+				}
+			}
+			sink = rasterizer.GetPixels()[0];
+		});
+}
+
+void SaveJson(const std::string& path) {
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("cannot create " + path);
+
+	file << "[\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		file << "\t{ \"name\": \"" << results[i].name << "\", \"iterations\": " << results[i].iterations << ", \"ns_per_op\": " << results[i].ns_per_op << " }";
+		file << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	file << "]\n";
+
+	if (!file)
+		throw std::runtime_error("cannot write " + path);
+}
+
+void BenchmarkSnapshots() {
+	static const int kTicks = 1000;
+
+	if (!Enabled("snapshot/"))
+		return;
+
+	const GameMap map(DATADIR "/maps/planetonomy.tmx");
+	GameWorld world(map);
+
+	// walk right and jump, so consecutive states differ
+	SnapshotRing history(kTicks);
+	std::vector<char> state;
+	for (int tick = 0; tick < kTicks; tick++) {
+		world.SetControlFlags((int)GameWorld::ControlFlags::RIGHT | (tick % 100 < 10 ? (int)GameWorld::ControlFlags::UP : 0));
+		world.Update(kTickDuration);
+		world.SaveState(state);
+		history.Push(state);
+	}
+
+	std::cerr << "snapshot: " << state.size() << " bytes full, " << history.GetDataSize() / history.GetSize() << " bytes average stored" << std::endl;
+
+	Benchmark("snapshot/save", 1, [&world, &state]() {
+			world.SaveState(state);
+		});
+
+	SnapshotRing ring(kTicks);
+	Benchmark("snapshot/push", 1, [&ring, &state]() {
+			ring.Push(state);
+		});
+
+	// older snapshots need deltas applied
+	Benchmark("snapshot/restore", 1, [&world, &history, &state]() {
+			history.Get(kTicks / 2 + 1, state);
+			world.LoadState(state);
+		});
+}
+
+void Usage(const char* progname) {
+	std::cerr << "Usage: " << progname << " [-f name_prefix] [-o results.json]" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) try {
+	std::string json_path;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else {
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	BenchmarkMapLoading();
+	BenchmarkGetTile();
+	BenchmarkCollision();
+	BenchmarkRendering();
+	BenchmarkSnapshots();
+
+	// tab separated results go to stdout, progress to stderr
+	for (const auto& result : results)
+		std::cout << result.name << "\t" << result.iterations << "\t" << result.ns_per_op << std::endl;
+
+	if (!json_path.empty())
+		SaveJson(json_path);
+
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return 1;
+} catch (...) {
+	std::cerr << "Unknown error" << std::endl;
+	return 1;
+}
@@ -30,4 +30,13 @@ constexpr int kAtlasWidthTiles = 16;
 constexpr int kScreenWidthTiles = kScreenWidthPixels / kTileSize;
 constexpr int kScreenHeightTiles = kScreenHeightPixels / kTileSize;
 
+// Simulation is run in fixed steps, independent of frame rate
+constexpr int kTicksPerSecond = 100;
+constexpr float kTickDuration = 1.0f / kTicksPerSecond;
+
+// Limit on number of ticks simulated in a single frame; if
+// simulation falls behind more than that, game slows down
+// instead of spending more and more time catching up
+constexpr int kMaxTicksPerFrame = 8;
+
 #endif // CONSTANTS_HH
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileWatcher.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+	fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd_ == -1)
+		throw std::runtime_error("cannot initialize inotify");
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+	close(fd_);
+#endif
+}
+
+void FileWatcher::Add(const std::string& path) {
+	const size_t slash = path.rfind('/');
+	const std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+	const std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+#ifdef __linux__
+	// adding a directory already watched returns the same descriptor
+	const int descriptor = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (descriptor == -1)
+		throw std::runtime_error("cannot watch " + dir);
+#else
+	const int descriptor = -1;
+#endif
+
+	watches_.emplace_back(Watch{descriptor, name, path});
+}
+
+std::vector<std::string> FileWatcher::Poll() {
+	std::vector<std::string> changed;
+
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+
+	ssize_t length;
+	while ((length = read(fd_, buffer, sizeof(buffer))) > 0) {
+		for (const char* ptr = buffer; ptr < buffer + length; ) {
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			if (event->len == 0)
+				continue;
+
+			for (const auto& watch : watches_)
+				if (watch.descriptor == event->wd && watch.name == event->name && std::find(changed.begin(), changed.end(), watch.path) == changed.end())
+					changed.push_back(watch.path);
+		}
+	}
+#endif
+
+	return changed;
+}
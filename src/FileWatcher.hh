@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILEWATCHER_HH
+#define FILEWATCHER_HH
+
+#include <string>
+#include <vector>
+
+// Notices changes of given files, without blocking
+//
+// Directories containing the files are watched rather than files
+// themselves, so files replaced by rename (which is how many
+// editors save) are noticed as well. Uses inotify on Linux and
+// never reports any changes elsewhere.
+class FileWatcher {
+private:
+	struct Watch {
+		int descriptor;
+		std::string name;
+		std::string path;
+	};
+
+private:
+	int fd_ = -1;
+	std::vector<Watch> watches_;
+
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	void Add(const std::string& path);
+
+	// Paths of watched files changed since last call
+	std::vector<std::string> Poll();
+};
+
+#endif // FILEWATCHER_HH
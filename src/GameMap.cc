@@ -20,193 +20,121 @@
 #include "GameMap.hh"
 
 #include <cstring>
-#include <iostream>
-
-#include <SDL2pp/Point.hh>
-
-#include <pugixml.hpp>
-
-GameMap::GameMap(const std::string& tmxpath) {
-	// prase .tmx xml
-	pugi::xml_document tmxdoc;
-
-	if (!tmxdoc.load_file(tmxpath.c_str()))
-		throw std::runtime_error("cannot load map file");
-
-	auto map = tmxdoc.child("map");
-
-	ParseTileset(map);
-	ParseMap(map);
-	ParseObjects(map);
+#include <stdexcept>
+
+#include "MapCompiler.hh"
+
+GameMap::GameMap(const std::string& path) : mapped_file_(path) {
+	// precompiled maps are used in place, anything else
+	// is treated as .tmx and compiled in memory
+	if (mapped_file_.GetSize() < sizeof(MapFormat::kMagic) || std::memcmp(mapped_file_.GetData(), MapFormat::kMagic, sizeof(MapFormat::kMagic)) != 0) {
+		mapped_file_ = MappedFile();
+		buffer_ = MapCompiler(path).GetBlob();
+		Attach(buffer_.data(), buffer_.size());
+	} else {
+		Attach(mapped_file_.GetData(), mapped_file_.GetSize());
+	}
 }
 
-void GameMap::ParseTileset(const pugi::xml_node& map) {
-	auto tileset = map.child("tileset");
-	int firstgid = tileset.attribute("firstgid").as_int();
-
-	int tilewidth = tileset.attribute("tilewidth").as_int();
-	int tileheight = tileset.attribute("tileheight").as_int();
-
-	int imagewidth = tileset.child("image").attribute("width").as_int();
-	int imageheight = tileset.child("image").attribute("height").as_int();
-
-	int tilesinrow = imagewidth / tilewidth;
-	int tilesincol = imageheight / tileheight;
-
-	if (tilewidth <= 0 || tileheight <= 0 || imagewidth <= 0 || imageheight <= 0)
-			throw std::runtime_error("cannot process map file: unexpected tileset dimensions");
-
-	// parse plain tiles
-	for (auto tile = tileset.child("tile"); tile; tile = tile.next_sibling("tile")) {
-		int global_id = tile.attribute("id").as_int() + firstgid;
-		if (global_id < 1)
-			throw std::runtime_error("cannot process map file: unexpected tile id");
-
-		TileInfo ti;
+GameMap::GameMap(std::vector<char>&& blob) : buffer_(std::move(blob)) {
+	Attach(buffer_.data(), buffer_.size());
+}
 
-		// properties
-		for (auto property = tile.child("properties").child("property"); property; property = property.next_sibling("property")) {
-			if (std::strcmp(property.attribute("name").as_string(), "deadly") == 0)
-				ti.deadly_flag = true;
-		}
+template <class T>
+static ArrayView<T> GetSection(const char* data, size_t size, const MapFormat::Section& section) {
+	if (section.offset % alignof(T) != 0 || section.offset > size || section.count > (size - section.offset) / sizeof(T))
+		throw std::runtime_error("cannot load precompiled map: bad section bounds");
 
-		// collision
-		for (auto rect = tile.child("objectgroup").child("object"); rect; rect = rect.next_sibling("object")) {
-			ti.collision_map.emplace_back(
-					rect.attribute("x").as_int(),
-					rect.attribute("y").as_int(),
-					rect.attribute("width").as_int(),
-					rect.attribute("height").as_int()
-				);
-		}
+	return ArrayView<T>(reinterpret_cast<const T*>(data + section.offset), section.count);
+}
 
-		tile_infos_.insert(std::make_pair(global_id, ti));
+void GameMap::Attach(const char* data, size_t size) {
+	if (size < sizeof(MapFormat::Header))
+		throw std::runtime_error("cannot load precompiled map: file too short");
+
+	const MapFormat::Header& header = *reinterpret_cast<const MapFormat::Header*>(data);
+
+	if (std::memcmp(header.magic, MapFormat::kMagic, sizeof(MapFormat::kMagic)) != 0)
+		throw std::runtime_error("cannot load precompiled map: bad magic");
+	if (header.version != MapFormat::kVersion)
+		throw std::runtime_error("cannot load precompiled map: unsupported version");
+	if (header.byte_order != MapFormat::kByteOrderMark)
+		throw std::runtime_error("cannot load precompiled map: byte order mismatch");
+
+	width_ = header.width;
+	height_ = header.height;
+	chunks_x_ = (width_ + MapFormat::kChunkSize - 1) / MapFormat::kChunkSize;
+	chunks_y_ = (height_ + MapFormat::kChunkSize - 1) / MapFormat::kChunkSize;
+
+	tile_infos_ = GetSection<TileInfo>(data, size, header.tile_infos);
+	collision_rects_ = GetSection<SDL2pp::Rect>(data, size, header.collision_rects);
+	tile_masks_ = GetSection<TileMask>(data, size, header.tile_masks);
+	map_data_ = GetSection<uint32_t>(data, size, header.map_data);
+	objects_ = GetSection<Object>(data, size, header.objects);
+	metatiles_ = GetSection<MapFormat::MetaTile>(data, size, header.metatiles);
+
+	// validate references between sections, so lookups
+	// don't need to check anything
+	if (tile_infos_.empty())
+		throw std::runtime_error("cannot load precompiled map: no tiles");
+	if (map_data_.size() != (size_t)chunks_x_ * chunks_y_ * MapFormat::kChunkTiles)
+		throw std::runtime_error("cannot load precompiled map: unexpected number of tiles in the map");
+
+	for (const auto& tileinfo : tile_infos_) {
+		if (tileinfo.collision_offset + (size_t)tileinfo.collision_count * NUM_FLIP_VARIANTS > collision_rects_.size() ||
+				tileinfo.mask_offset + (size_t)NUM_FLIP_VARIANTS > tile_masks_.size())
+			throw std::runtime_error("cannot load precompiled map: bad tile info");
 	}
 
-	// fill rects for all tiles possibly present in the tileset
-	for (int id = 0; id < tilesinrow * tilesincol; id++) {
-		int global_id = id + firstgid;
-		tile_infos_[global_id].source_rect = SDL2pp::Rect(
-				(id % tilesinrow) * tilewidth,
-				(id / tilesinrow) * tileheight,
-				tilewidth,
-				tileheight
-			);
+	for (const auto& object : objects_) {
+		if ((unsigned int)object.type >= NUM_OBJECT_TYPES)
+			throw std::runtime_error("cannot load precompiled map: bad object type");
 	}
 
-	// parse metatiles tiles
-	for (auto tile = tileset.child("tile"); tile; tile = tile.next_sibling("tile")) {
-		int global_id = tile.attribute("id").as_int() + firstgid;
-		if (global_id < 1)
-			throw std::runtime_error("cannot process map file: unexpected tile id");
-
-		int width = 1;
-		int height = 1;
-		std::string name;
-
-		for (auto property = tile.child("properties").child("property"); property; property = property.next_sibling("property")) {
-			if (std::strcmp(property.attribute("name").as_string(), "width") == 0)
-				width = property.attribute("value").as_int();
-			else if (std::strcmp(property.attribute("name").as_string(), "height") == 0)
-				height = property.attribute("value").as_int();
-			else if (std::strcmp(property.attribute("name").as_string(), "name") == 0)
-				name = property.attribute("value").as_string();
-		}
-
-		if (name == "") // not a metatile
-			continue;
-
-		if (width < 1 || height < 1)
-			throw std::runtime_error("cannot process map file: invalid metatile size");
-
-		MetaTileInfo mti;
+	if (!std::is_sorted(objects_.begin(), objects_.end(), [](const Object& a, const Object& b) { return a.type < b.type; }))
+		throw std::runtime_error("cannot load precompiled map: objects not sorted");
 
-		mti.source_rect = tile_infos_[global_id].source_rect;
-		mti.source_rect.w = width * tilewidth;
-		mti.source_rect.h = height * tileheight;
-
-		for (int y = 0; y < height; y++)
-			for (int x = 0; x < height; x++)
-				for (const auto& rect : tile_infos_[global_id].collision_map)
-					mti.collision_map.push_back(rect + SDL2pp::Point(x * tilewidth, y * tileheight));
-
-		metatile_infos_.insert(std::make_pair(name, mti));
+	for (const auto& metatile : metatiles_) {
+		if (metatile.collision_offset + (size_t)metatile.collision_count > collision_rects_.size() ||
+				metatile.name[sizeof(metatile.name) - 1] != '\0')
+			throw std::runtime_error("cannot load precompiled map: bad metatile info");
 	}
+}
 
-	tile_infos_.insert(std::make_pair(0, TileInfo())); // add empty tile
+unsigned int GameMap::GetWidth() const {
+	return width_;
 }
 
-void GameMap::ParseMap(const pugi::xml_node& map) {
-	width_ = map.attribute("width").as_int();
-	height_ = map.attribute("height").as_int();
-	std::string map_csv = map.child("layer").child_value("data");
-
-	if (width_ == 0 || height_ == 0 || map_csv.empty())
-		throw std::runtime_error("cannot parse map file: cannot get map dimensions or contents");
-
-	map_data_.reserve(width_ * height_);
-
-	// parse tile array
-	unsigned int curint = 0;
-	unsigned int curlen = 0;
-	for (auto& ch : map_csv) {
-		if (ch >= '0' && ch <= '9') {
-			curint = curint * 10 + ch - '0';
-			curlen++;
-		} else {
-			if (curlen)
-				map_data_.push_back(curint);
-			curint = 0;
-			curlen = 0;
-		}
-	}
+unsigned int GameMap::GetHeight() const {
+	return height_;
+}
 
-	if (map_data_.size() != width_ * height_)
-		throw std::runtime_error("cannot parse map file: unexpected number of tiles in the map");
+size_t GameMap::GetDataSize() const {
+	return buffer_.size() + mapped_file_.GetSize();
 }
 
-void GameMap::ParseObjects(const pugi::xml_node& map) {
-	pugi::xml_node objects_group;
-	for (auto objectgroup = map.child("objectgroup"); objectgroup; objectgroup = objectgroup.next_sibling("objectgroup"))
-		if (std::strcmp(objectgroup.attribute("name").as_string(), "Objects") == 0)
-			objects_group = objectgroup;
-
-	if (!objects_group)
-		throw std::runtime_error("cannot parse map file: objects layer not found");
-
-	for (auto object = objects_group.child("object"); object; object = object.next_sibling("object")) {
-		ObjectTypes type;
-
-		const auto objtypename = object.attribute("type").as_string();
-		if (std::strcmp(objtypename, "lander") == 0) {
-			type = LANDER;
-		} else if (std::strcmp(objtypename, "player_start") == 0) {
-			type = PLAYER_START;
-		} else if (std::strcmp(objtypename, "mouth_monster") == 0) {
-			type = MOUTH_MONSTER;
-		} else {
-			std::cerr << "WARNING: Unknown object type: " << objtypename << std::endl;
-			continue;
-		}
+unsigned int GameMap::GetChunksX() const {
+	return chunks_x_;
+}
 
-		objects_.emplace_back(Object{
-				type,
-				{
-					object.attribute("x").as_int(),
-					object.attribute("y").as_int(),
-					object.attribute("width").as_int(),
-					object.attribute("height").as_int()
-				}
-			});
-	}
+unsigned int GameMap::GetChunksY() const {
+	return chunks_y_;
 }
 
-unsigned int GameMap::GetWidth() const {
-	return width_;
+void GameMap::PrefetchChunk(unsigned int cx, unsigned int cy) const {
+	if (mapped_file_.GetData() == nullptr || cx >= chunks_x_ || cy >= chunks_y_)
+		return;
+
+	size_t offset = reinterpret_cast<const char*>(map_data_.data()) - mapped_file_.GetData();
+	mapped_file_.Prefetch(offset + ((size_t)cy * chunks_x_ + cx) * MapFormat::kChunkBytes, MapFormat::kChunkBytes);
 }
 
-unsigned int GameMap::GetHeight() const {
-	return height_;
+void GameMap::EvictChunk(unsigned int cx, unsigned int cy) const {
+	if (mapped_file_.GetData() == nullptr || cx >= chunks_x_ || cy >= chunks_y_)
+		return;
+
+	size_t offset = reinterpret_cast<const char*>(map_data_.data()) - mapped_file_.GetData();
+	mapped_file_.Evict(offset + ((size_t)cy * chunks_x_ + cx) * MapFormat::kChunkBytes, MapFormat::kChunkBytes);
 }
 
 GameMap::Tile GameMap::GetTile(int x, int y) const {
@@ -219,42 +147,133 @@ GameMap::Tile GameMap::GetTile(int x, int y) const {
 	if (x < 0 || y < 0 || (unsigned int)x >= width_ || (unsigned int)y >= height_)
 		tile_id = default_tile_id;
 	else
-		tile_id = map_data_[y * width_ + x];
+		tile_id = map_data_[
+			((size_t)((unsigned int)y / MapFormat::kChunkSize) * chunks_x_ + (unsigned int)x / MapFormat::kChunkSize) * MapFormat::kChunkTiles +
+			((unsigned int)y % MapFormat::kChunkSize) * MapFormat::kChunkSize + (unsigned int)x % MapFormat::kChunkSize
+		];
 
 	return Tile(tile_id, *this);
 }
 
+int GameMap::ProbeRow(int x, int y, int length) const {
+	int begin = std::max(x, 0);
+	int end = x + length;
+
+	if (y < 0 || begin >= end)
+		return 0;
+
+	int result = 0;
+	for (int tx = begin / kTileSize; tx * kTileSize < end; tx++) {
+		int first = std::max(begin - tx * kTileSize, 0);
+		int last = std::min(end - tx * kTileSize, kTileSize);
+		unsigned int span = (1u << last) - (1u << first);
+
+		Tile tile = GetTile(tx, y / kTileSize);
+		if (tile.GetMask().rows[y % kTileSize] & span) {
+			result |= PROBE_SOLID;
+			if (tile.IsDeadly())
+				return result | PROBE_DEADLY;
+		}
+	}
+
+	return result;
+}
+
+int GameMap::ProbeColumn(int x, int y, int length) const {
+	int begin = std::max(y, 0);
+	int end = y + length;
+
+	if (x < 0 || begin >= end)
+		return 0;
+
+	int result = 0;
+	for (int ty = begin / kTileSize; ty * kTileSize < end; ty++) {
+		int first = std::max(begin - ty * kTileSize, 0);
+		int last = std::min(end - ty * kTileSize, kTileSize);
+		unsigned int span = (1u << last) - (1u << first);
+
+		Tile tile = GetTile(x / kTileSize, ty);
+		if (tile.GetMask().cols[x % kTileSize] & span) {
+			result |= PROBE_SOLID;
+			if (tile.IsDeadly())
+				return result | PROBE_DEADLY;
+		}
+	}
+
+	return result;
+}
+
+int GameMap::ProbeRect(const SDL2pp::Rect& rect) const {
+	int xbegin = std::max(rect.x, 0);
+	int xend = rect.x + rect.w;
+	int ybegin = std::max(rect.y, 0);
+	int yend = rect.y + rect.h;
+
+	if (xbegin >= xend || ybegin >= yend)
+		return 0;
+
+	int result = 0;
+	for (int ty = ybegin / kTileSize; ty * kTileSize < yend; ty++) {
+		int firsty = std::max(ybegin - ty * kTileSize, 0);
+		int lasty = std::min(yend - ty * kTileSize, kTileSize);
+
+		for (int tx = xbegin / kTileSize; tx * kTileSize < xend; tx++) {
+			int firstx = std::max(xbegin - tx * kTileSize, 0);
+			int lastx = std::min(xend - tx * kTileSize, kTileSize);
+			unsigned int span = (1u << lastx) - (1u << firstx);
+
+			Tile tile = GetTile(tx, ty);
+			const TileMask& mask = tile.GetMask();
+			for (int y = firsty; y < lasty; y++) {
+				if (mask.rows[y] & span) {
+					result |= PROBE_SOLID;
+					if (tile.IsDeadly())
+						return result | PROBE_DEADLY;
+					break;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
 const GameMap::TileInfo& GameMap::GetTileInfo(unsigned int id) const {
-	auto tileinfo_it = tile_infos_.find(id);
-	if (tileinfo_it == tile_infos_.end())
-		tileinfo_it = tile_infos_.find(0);
+	// unknown ids are treated as empty tile
+	if (id >= tile_infos_.size())
+		id = 0;
 
-	return tileinfo_it->second;
+	return tile_infos_[id];
 }
 
-const GameMap::MetaTileInfo& GameMap::GetMetaTileInfo(const std::string& name) const {
-	auto metatileinfo_it = metatile_infos_.find(name);
-	if (metatileinfo_it == metatile_infos_.cend())
-		throw std::runtime_error("unknown metatile name");
+GameMap::MetaTileInfo GameMap::GetMetaTileInfo(const std::string& name) const {
+	for (const auto& metatile : metatiles_) {
+		if (name == metatile.name) {
+			return MetaTileInfo{
+				metatile.source_rect,
+				CollisionSpan(collision_rects_.data() + metatile.collision_offset, metatile.collision_count)
+			};
+		}
+	}
 
-	return metatileinfo_it->second;
+	throw std::runtime_error("unknown metatile name");
 }
 
 const GameMap::Object& GameMap::GetObject(GameMap::ObjectTypes type) const {
-	for (auto& obj : objects_)
-		if (obj.type == type)
-			return obj;
+	ArrayView<Object> objects = GetObjects(type);
+	if (objects.empty())
+		throw std::runtime_error("required object not found");
 
-	throw std::runtime_error("required object not found");
+	return objects[0];
 }
 
-void GameMap::ForeachObject(std::function<void(const GameMap::Object&)> processor) const {
-	for (auto& obj : objects_)
-		processor(obj);
+const ArrayView<GameMap::Object>& GameMap::GetObjects() const {
+	return objects_;
 }
 
-void GameMap::ForeachObject(GameMap::ObjectTypes type, std::function<void(const GameMap::Object&)> processor) const {
-	for (auto& obj : objects_)
-		if (obj.type == type)
-			processor(obj);
+ArrayView<GameMap::Object> GameMap::GetObjects(GameMap::ObjectTypes type) const {
+	auto range = std::equal_range(objects_.begin(), objects_.end(), Object{type, SDL2pp::Rect()},
+			[](const Object& a, const Object& b) { return a.type < b.type; });
+
+	return ArrayView<Object>(range.first, range.second - range.first);
 }
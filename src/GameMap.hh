@@ -22,94 +22,115 @@
 
 #include <string>
 #include <vector>
-#include <unordered_map>
-#include <map>
-#include <functional>
 #include <algorithm>
+#include <cstdint>
 
 #include <SDL2pp/Rect.hh>
 
+#include "ArrayView.hh"
 #include "Constants.hh"
-
-namespace pugi {
-	class xml_node;
-}
+#include "MapFormat.hh"
+#include "MappedFile.hh"
 
 class GameMap {
 public:
 	typedef std::vector<SDL2pp::Rect> CollisionMap;
+	typedef ArrayView<SDL2pp::Rect> CollisionSpan;
+
+	// Combinations of tiled's flipping flags; value matches
+	// the top 3 bits of tile data
+	enum TileFlips {
+		DFLIP = 0x1,
+		VFLIP = 0x2,
+		HFLIP = 0x4,
+
+		NUM_FLIP_VARIANTS = 8
+	};
 
+	// Per-pixel solidity of a tile, one bit per pixel, stored
+	// both by rows and by columns for fast side probes
+	struct TileMask {
+		uint16_t rows[kTileSize] = {};
+		uint16_t cols[kTileSize] = {};
+	};
+
+	static_assert(kTileSize == 16, "TileMask assumes 16 pixel tiles");
+
+	// Results of pixel span probes
+	enum ProbeFlags {
+		PROBE_SOLID = 0x1,
+		PROBE_DEADLY = 0x2,
+	};
+
+	// Plain data, stored as is in precompiled maps
 	struct TileInfo {
 		SDL2pp::Rect source_rect;
-		CollisionMap collision_map;
-		bool deadly_flag = false;
+		uint32_t deadly_flag = 0;
 
-		TileInfo() {
-		}
+		// offset of pretransformed collision maps in
+		// GameMap::collision_rects_, one per flip variant,
+		// each collision_count rects long
+		uint32_t collision_offset = 0;
+		uint32_t collision_count = 0;
+
+		// offset of rasterized collision masks in
+		// GameMap::tile_masks_, one per flip variant
+		uint32_t mask_offset = 0;
 	};
 
 	struct MetaTileInfo {
 		SDL2pp::Rect source_rect;
-		CollisionMap collision_map;
+		CollisionSpan collision_map;
 	};
 
 	class Tile {
 	private:
 		unsigned int data_;
 		const TileInfo& info_;
+		const GameMap& map_;
 
 	public:
 		Tile(unsigned int data, const GameMap& map)
 			: data_(data),
-			  info_(map.GetTileInfo(GetType())) {
+			  info_(map.GetTileInfo(GetType())),
+			  map_(map) {
 		}
 
 		unsigned int GetType() const {
 			return data_ & 0x0fffffff;
 		}
 
-		bool IsHFlipped() const {
+		unsigned int GetFlips() const {
 			// http://doc.mapeditor.org/reference/tmx-map-format/#tile-flipping
-			return data_ & 0x80000000;
+			return data_ >> 29;
+		}
+
+		bool IsHFlipped() const {
+			return GetFlips() & HFLIP;
 		}
 
 		bool IsVFlipped() const {
-			// http://doc.mapeditor.org/reference/tmx-map-format/#tile-flipping
-			return data_ & 0x40000000;
+			return GetFlips() & VFLIP;
 		}
 
 		bool IsDFlipped() const {
-			// http://doc.mapeditor.org/reference/tmx-map-format/#tile-flipping
-			return data_ & 0x20000000;
+			return GetFlips() & DFLIP;
 		}
 
 		bool IsFlipped() const {
-			return IsDFlipped() || IsHFlipped() || IsVFlipped();
+			return GetFlips() != 0;
 		}
 
 		bool IsDeadly() const {
 			return info_.deadly_flag;
 		}
 
-		CollisionMap GetCollisionMap() const {
-			if (!IsFlipped())
-				return info_.collision_map;
-
-			// Transform collision map based on tile flips
-			CollisionMap transformed_map;
-			for (auto rect : info_.collision_map) {
-				if (IsDFlipped()) {
-					std::swap(rect.x, rect.y);
-					std::swap(rect.w, rect.h);
-				}
-				if (IsHFlipped())
-					rect.x = kTileSize - rect.x - rect.w;
-				if (IsVFlipped())
-					rect.y = kTileSize - rect.y - rect.h;
-
-				transformed_map.emplace_back(rect);
-			}
-			return transformed_map;
+		CollisionSpan GetCollisionMap() const {
+			return CollisionSpan(map_.collision_rects_.data() + info_.collision_offset + GetFlips() * info_.collision_count, info_.collision_count);
+		}
+
+		const TileMask& GetMask() const {
+			return map_.tile_masks_[info_.mask_offset + GetFlips()];
 		}
 
 		const SDL2pp::Rect& GetSourceRect() const {
@@ -121,6 +142,9 @@ public:
 		LANDER,
 		PLAYER_START,
 		MOUTH_MONSTER,
+		CHECKPOINT,
+
+		NUM_OBJECT_TYPES
 	};
 
 	struct Object {
@@ -128,33 +152,75 @@ public:
 		SDL2pp::Rect rect;
 	};
 
-protected:
-	std::unordered_map<unsigned int, TileInfo> tile_infos_;
-	std::vector<unsigned int> map_data_;
+private:
+	// backing storage for the data below; either map compiled
+	// from .tmx in memory, or mapping of precompiled map file
+	std::vector<char> buffer_;
+	MappedFile mapped_file_;
+
 	unsigned int width_;
 	unsigned int height_;
+	unsigned int chunks_x_;
+	unsigned int chunks_y_;
+
+	// dense table indexed by global tile id; slot 0 is the empty tile
+	ArrayView<TileInfo> tile_infos_;
+	ArrayView<SDL2pp::Rect> collision_rects_;
+	ArrayView<TileMask> tile_masks_;
+	ArrayView<uint32_t> map_data_; // chunked, see MapFormat
+
+	ArrayView<Object> objects_; // sorted by type
 
-	std::vector<Object> objects_;
+	ArrayView<MapFormat::MetaTile> metatiles_;
 
-	std::map<std::string, MetaTileInfo> metatile_infos_;
+private:
+	void Attach(const char* data, size_t size);
 
 public:
-	GameMap(const std::string& tmxpath);
+	// Loads either .tmx or precompiled map, based on file contents
+	GameMap(const std::string& path);
 
-	void ParseTileset(const pugi::xml_node& map);
-	void ParseMap(const pugi::xml_node& map);
-	void ParseObjects(const pugi::xml_node& map);
+	// Uses precompiled map in memory, see MapCompiler
+	GameMap(std::vector<char>&& blob);
+
+	GameMap(const GameMap&) = delete;
+	GameMap& operator=(const GameMap&) = delete;
 
 	unsigned int GetWidth() const;
 	unsigned int GetHeight() const;
 
+	// Bytes of map data, either in memory or mapped
+	size_t GetDataSize() const;
+
+	// Map is split into square chunks of MapFormat::kChunkSize tiles
+	unsigned int GetChunksX() const;
+	unsigned int GetChunksY() const;
+
+	// Paging hints for chunk data, asynchronous; only have effect
+	// for precompiled maps used in place, as others are fully
+	// loaded into memory anyway
+	void PrefetchChunk(unsigned int cx, unsigned int cy) const;
+	void EvictChunk(unsigned int cx, unsigned int cy) const;
+
 	Tile GetTile(int x, int y) const;
 	const TileInfo& GetTileInfo(unsigned int id) const;
-	const MetaTileInfo& GetMetaTileInfo(const std::string& name) const;
+	MetaTileInfo GetMetaTileInfo(const std::string& name) const;
 
+	// Check horizontal span [x, x + length) of pixels at row y
+	// and vertical span [y, y + length) at column x against map
+	// collision masks; returns a combination of ProbeFlags.
+	// Pixels with negative coordinates are never solid
+	int ProbeRow(int x, int y, int length) const;
+	int ProbeColumn(int x, int y, int length) const;
+
+	// Same as above, for all pixels of a rect
+	int ProbeRect(const SDL2pp::Rect& rect) const;
+
+	// First object of given type
 	const Object& GetObject(ObjectTypes type) const;
-	void ForeachObject(std::function<void(const Object&)> processor) const;
-	void ForeachObject(ObjectTypes type, std::function<void(const Object&)> processor) const;
+
+	const ArrayView<Object>& GetObjects() const;
+	ArrayView<Object> GetObjects(ObjectTypes type) const;
 };
 
 #endif // GAMEMAP_HH
@@ -20,286 +20,369 @@
 #include "GameScene.hh"
 
 #include <algorithm>
-#include <cmath>
-#include <cassert>
+#include <iostream>
 
 #include "Constants.hh"
-#include "Physics.hh"
 #include "Sprites.hh"
 
-GameScene::GameScene(Application& app)
+// how far back the world may be rewound
+static const unsigned int kHistoryTicks = 10 * kTicksPerSecond;
+
+GameScene::GameScene(Application& app, AssetLoader::Assets assets, LowresPainter::Backend backend, const std::string& record_path, const std::string& replay_path)
 	: Scene(app),
-	  tiles_(GetRenderer(), DATADIR "/images/tiles.png"),
-	  game_map_(DATADIR "/maps/planetonomy.tmx"),
-	  painter_(GetRenderer(), tiles_, kScreenWidthPixels, kScreenHeightPixels),
-	  prev_frame_time_(SDL_GetTicks()),
-	  player_(game_map_.GetMetaTileInfo("player")),
-	  lander_(game_map_.GetMetaTileInfo("lander")) {
+	  game_map_(assets.map),
+	  atlas_(assets.atlas),
+	  map_streamer_(*game_map_),
+	  painter_(GetRenderer(), *atlas_, assets.atlas_texture, kScreenWidthPixels, kScreenHeightPixels, backend),
+	  ground_cache_(GetRenderer(), kScreenWidthPixels, kScreenHeightPixels),
+	  world_(*game_map_),
+	  history_(kHistoryTicks),
+	  record_path_(record_path),
+	  replaying_(!replay_path.empty()),
+	  replay_reader_(replay_),
+	  map_path_(assets.map_path),
+	  tiles_path_(assets.tiles_path) {
+	if (replaying_)
+		replay_.Load(replay_path);
+
+	// trace of a game with assets changing midway is useless
+	if (record_path_.empty() && !replaying_) {
+		try {
+			watcher_.reset(new FileWatcher);
+			watcher_->Add(map_path_);
+			watcher_->Add(tiles_path_);
+		} catch (std::runtime_error& e) {
+			std::cerr << "Hot reload disabled: " << e.what() << std::endl;
+			watcher_.reset();
+		}
+	}
 
-	player_.Place(game_map_.GetObject(GameMap::PLAYER_START).rect);
-	lander_.Place(game_map_.GetObject(GameMap::LANDER).rect);
+	world_.SaveState(snapshot_);
+	history_.Push(snapshot_);
+	checkpoints_.emplace_back(Checkpoint{world_.GetTicks(), world_.GetCheckpoint(), snapshot_});
 
 	painter_.UpdateSize();
 }
 
+SDL2pp::Point GameScene::GetScreenOffset(const SDL2pp::Point& player_anchor) {
+	return SDL2pp::Point{
+		player_anchor.x / (kScreenWidthTiles * kTileSize) * (kScreenWidthTiles * kTileSize),
+		player_anchor.y / (kScreenHeightTiles * kTileSize) * (kScreenHeightTiles * kTileSize)
+	};
+}
+
 void GameScene::ProcessEvent(const SDL_Event& event) {
 	if (event.type == SDL_QUIT) {
-		SetExit(true);
+		Quit();
 		return;
 	} else if (event.type == SDL_KEYDOWN && event.key.repeat == 0) {
 		switch (event.key.keysym.sym) {
 		case SDLK_ESCAPE: case SDLK_q:
-			SetExit(true);
+			Quit();
 			return;
+		case SDLK_F3:
+			show_profiler_ = !show_profiler_;
+			break;
+		case SDLK_BACKSPACE:
+			// replays are not interactive
+			rewinding_ = !replaying_;
+			break;
 		case SDLK_LEFT:
-			control_flags_ |= (int)ControlFlags::LEFT;
-			player_facing_right_ = false;
+			control_flags_ |= (int)GameWorld::ControlFlags::LEFT;
 			break;
 		case SDLK_RIGHT:
-			control_flags_ |= (int)ControlFlags::RIGHT;
-			player_facing_right_ = true;
+			control_flags_ |= (int)GameWorld::ControlFlags::RIGHT;
 			break;
 		case SDLK_UP:
-			control_flags_ |= (int)ControlFlags::UP;
+			control_flags_ |= (int)GameWorld::ControlFlags::UP;
 			break;
 		}
 	} else if (event.type == SDL_KEYUP) {
 		switch (event.key.keysym.sym) {
+		case SDLK_BACKSPACE:
+			rewinding_ = false;
+			break;
 		case SDLK_LEFT:
-			control_flags_ &= ~(int)ControlFlags::LEFT;
+			control_flags_ &= ~(int)GameWorld::ControlFlags::LEFT;
 			break;
 		case SDLK_RIGHT:
-			control_flags_ &= ~(int)ControlFlags::RIGHT;
+			control_flags_ &= ~(int)GameWorld::ControlFlags::RIGHT;
 			break;
 		case SDLK_UP:
-			control_flags_ &= ~(int)ControlFlags::UP;
+			control_flags_ &= ~(int)GameWorld::ControlFlags::UP;
 			break;
 		}
 	} else if (event.type == SDL_WINDOWEVENT) {
 		painter_.UpdateSize();
+	} else if (event.type == SDL_RENDER_TARGETS_RESET) {
+		ground_cache_.Clear();
 	}
 }
 
-void GameScene::Update() {
-	// update time
-	unsigned int frame_time = SDL_GetTicks();
-	float delta_time = (frame_time - prev_frame_time_) / 1000.0f; // seconds
-	prev_frame_time_ = frame_time;
+void GameScene::Update(float delta_time) {
+	CheckReload();
 
-	UpdatePlayer(delta_time);
-}
+	// time runs backwards while rewind key is held
+	if (rewinding_) {
+		Rewind(1);
+		return;
+	}
 
-void GameScene::UpdatePlayer(float delta_time) {
-	// Make gravity work
-	player_.yvel += kGForce * delta_time;
+	if (replaying_) {
+		if (replay_reader_.AtEnd()) {
+			std::cerr << "Replay finished after " << world_.GetTicks() << " ticks" << (diverged_ ? "" : ", no divergence found") << std::endl;
+			Quit();
+			return;
+		}
+		world_.SetControlFlags(replay_reader_.Next());
+	} else {
+		world_.SetControlFlags(control_flags_);
+	}
 
-	float original_yvel = player_.yvel;
+	world_.Update(delta_time);
 
-	// Update player position
-	int moveresult = MoveWithCollision(player_, delta_time);
+	const unsigned long ticks = world_.GetTicks();
 
-	// Handle some death conditions
-	if (moveresult & (int)CollisionState::DEADLY) {
-		Death("you've touched something deadly");
-		return;
+	if (!record_path_.empty()) {
+		recording_.Append(world_.GetControlFlags());
+		if (recording_.IsHashTick(ticks))
+			recording_.AppendHash(world_.GetStateHash());
 	}
-	if (moveresult & (int)CollisionState::BOTTOM && original_yvel >= kFatalSpeed) {
-		Death("you fell to your death");
-		return;
+
+	if (replaying_ && !diverged_ && replay_.IsHashTick(ticks) && !replay_.CheckHash(ticks, world_.GetStateHash())) {
+		std::cerr << "Replay diverged from recording at tick " << ticks << std::endl;
+		diverged_ = true;
 	}
 
-	// Process player controls
-	bool on_ground = (moveresult & (int)CollisionState::BOTTOM) && player_.yvel >= 0.0f;
-	float control_rate = on_ground ? 1.0 : kAirControlRate;
-
-	// Move left/right
-	if (control_flags_ & (int)ControlFlags::LEFT && player_.xvel >= -kWalkMaxSpeed) {
-		player_.xvel = std::max(-kWalkMaxSpeed, player_.xvel - control_rate * kWalkAccel * delta_time);
-	} else if (control_flags_ & (int)ControlFlags::RIGHT && player_.xvel <= kWalkMaxSpeed) {
-		player_.xvel = std::min(kWalkMaxSpeed, player_.xvel + control_rate * kWalkAccel * delta_time);
-	} else if (on_ground) { // decelerate when on ground
-		if (player_.xvel > 0)
-			player_.xvel -= std::min(player_.xvel, kWalkDecel * delta_time);
-		if (player_.xvel < 0)
-			player_.xvel += std::min(-player_.xvel, kWalkDecel * delta_time);
+	if (world_.IsDead()) {
+		Death(world_.GetDeathReason());
+		return;
 	}
 
-	// Jump
-	if (on_ground && control_flags_ & (int)ControlFlags::UP)
-		player_.yvel -= kJumpImpulse;
-}
+	world_.SaveState(snapshot_);
+	history_.Push(snapshot_);
 
-void GameScene::Render() {
-	// clear whole window to make actualy rendering area visible
-	SDL2pp::Rect clip = GetRenderer().GetClipRect();
-	GetRenderer().SetClipRect();
-	GetRenderer().SetDrawColor(16, 16, 16);
-	GetRenderer().Clear();
-	GetRenderer().SetClipRect(clip);
+	if (world_.GetCheckpoint() != checkpoints_.back().index)
+		checkpoints_.emplace_back(Checkpoint{world_.GetTicks(), world_.GetCheckpoint(), snapshot_});
 
+	const SDL2pp::Point player_anchor = world_.GetPlayer().GetAnchor();
+	map_streamer_.Update(GetScreenOffset(player_anchor), player_anchor);
+}
+
+void GameScene::Render(float alpha) {
 	// low-res rendering starts
-	GetRenderer().SetDrawColor(0, 0, 0);
-	painter_.Clear();
+	painter_.Clear(0, 0, 0);
 
-	SDL2pp::Point screen_offset{
-		player_.GetAnchor().x / (kScreenWidthTiles * kTileSize) * (kScreenWidthTiles * kTileSize),
-		player_.GetAnchor().y / (kScreenHeightTiles * kTileSize) * (kScreenHeightTiles * kTileSize)
-	};
+	const SDL2pp::Point screen_offset = GetScreenOffset(world_.GetPlayer().GetInterpolatedAnchor(alpha));
 
 	RenderGround(screen_offset);
-	RenderLander(screen_offset);
-	RenderPlayer(screen_offset);
+	RenderLander(screen_offset, alpha);
+	RenderMonsters(screen_offset, alpha);
+	RenderPlayer(screen_offset, alpha);
+
+	if (show_profiler_)
+		RenderProfiler();
+
+	painter_.Present();
 }
 
 void GameScene::RenderGround(const SDL2pp::Point& offset) {
+	// software backend has no target textures to cache into,
+	// and blitting a screen of tiles on CPU is cheap anyway
+	if (!painter_.IsAccelerated()) {
+		RenderGroundTiles(offset);
+		return;
+	}
+
+	// ground only changes when camera moves to another screen
+	SDL2pp::Texture& ground = ground_cache_.Get(offset, [this, &offset]() {
+		RenderGroundTiles(offset);
+		painter_.Flush();
+	});
+	painter_.Copy(ground, SDL2pp::Point(0, 0));
+}
+
+// Draws ground tiles into current render target
+void GameScene::RenderGroundTiles(const SDL2pp::Point& offset) {
 	for (int y = 0; y < (kScreenHeightPixels + kTileSize - 1) / kTileSize; y++) {
 		for (int x = 0; x < kScreenWidthTiles; x++) {
-			GameMap::Tile tt = game_map_.GetTile(offset.x / kTileSize + x, offset.y / kTileSize + y);
+			GameMap::Tile tt = game_map_->GetTile(offset.x / kTileSize + x, offset.y / kTileSize + y);
 
 			if (tt.GetType() == 0)
 				continue;
 
-			if (tt.IsFlipped()) {
-				// handle tiled's flipping flags
-				int flipflag = 0;
-				double angle = 0.0;
-				if (tt.IsDFlipped()) {
-					flipflag = (tt.IsHFlipped() ? 0 : SDL_FLIP_VERTICAL) | (tt.IsVFlipped() ? SDL_FLIP_HORIZONTAL : 0);
-					angle = 90.0;
-				} else {
-					flipflag = (tt.IsHFlipped() ? SDL_FLIP_HORIZONTAL : 0) | (tt.IsVFlipped() ? SDL_FLIP_VERTICAL : 0);
-					angle = 0.0;
-				}
-
-				painter_.Copy(
-						tt.GetSourceRect(),
-						SDL2pp::Point(x * kTileSize, y * kTileSize),
-						angle,
-						SDL2pp::NullOpt,
-						flipflag
-					);
-			} else {
-				painter_.Copy(
-						tt.GetSourceRect(),
-						SDL2pp::Point(x * kTileSize, y * kTileSize)
-					);
-			}
+			painter_.Copy(tt.GetSourceRect(), SDL2pp::Point(x * kTileSize, y * kTileSize), tt.GetFlips());
 		}
 	}
 }
 
-void GameScene::RenderPlayer(const SDL2pp::Point& offset) {
+void GameScene::RenderPlayer(const SDL2pp::Point& offset, float alpha) {
 	painter_.Copy(
-			player_.GetSrcRect(),
-			player_.GetPoint() - offset,
-			0.0,
-			SDL2pp::NullOpt,
-			player_facing_right_ ? 0 : SDL_FLIP_HORIZONTAL
+			world_.GetPlayer().GetSrcRect(),
+			world_.GetPlayer().GetInterpolatedPoint(alpha) - offset,
+			world_.IsPlayerFacingRight() ? 0 : GameMap::HFLIP
 		);
 }
 
-void GameScene::RenderLander(const SDL2pp::Point& offset) {
+void GameScene::RenderLander(const SDL2pp::Point& offset, float alpha) {
 	painter_.Copy(
-			lander_.GetSrcRect(),
-			lander_.GetPoint() - offset
+			world_.GetLander().GetSrcRect(),
+			world_.GetLander().GetInterpolatedPoint(alpha) - offset
 		);
 }
 
-int GameScene::MoveWithCollision(GameScene::DynamicObject& object, float delta_time) const {
-	// move in 1 pixel steps, checking collisions on each step
-	int num_steps = 1 + (int)(std::max(std::abs(object.xvel), std::abs(object.yvel)) * delta_time);
-
-	int result = (int)CollisionState::NONE;
-	for (int step = 0; step < num_steps && (object.xvel != 0.0f || object.yvel != 0.0f); step++) {
-		result = (int)CollisionState::NONE;
-
-		// try normal collision
-		object.ForeachCollisionRect([&result, this](const SDL2pp::Rect& rect){
-				result |= CheckCollisionWithStatic(rect);
-			});
-
-		// if applicable, try autostep
-		if (result & (int)CollisionState::BOTTOM &&
-				((result & (int)CollisionState::LEFT && object.xvel < 0.0f) ||
-				(result & (int)CollisionState::RIGHT && object.xvel > 0.0f))) {
-			for (int autostep = 1; autostep <= kAutoStepAmount; autostep++) {
-				int tryresult = (int)CollisionState::NONE;
-
-				object.ForeachCollisionRect([&tryresult, autostep, this](const SDL2pp::Rect& rect){
-						tryresult |= CheckCollisionWithStatic(rect - SDL2pp::Point(0, autostep));
-					});
-
-				if (tryresult == (int)CollisionState::NONE) {
-					result = tryresult;
-					object.y -= autostep;
-					break;
-				}
-			}
+void GameScene::RenderMonsters(const SDL2pp::Point& offset, float alpha) {
+	world_.ForeachMonster(SDL2pp::Rect(offset.x, offset.y, kScreenWidthPixels, kScreenHeightPixels), [this, &offset, alpha](const ObjectPool::Object& monster) {
+			painter_.Copy(monster.GetSrcRect(), monster.GetInterpolatedPoint(alpha) - offset);
+		});
+}
+
+// Graph of recent frame times at the bottom of the screen, one
+// column per frame with newest on the right. Main loop stages are
+// stacked over total frame time in grey, and lines mark median and
+// 99th percentile of frame time
+void GameScene::RenderProfiler() {
+	static const float kPixelsPerMs = 4.0f;
+	static const int kGraphHeight = 80;
+
+	static const struct {
+		Profiler::Timer timer;
+		Uint8 r, g, b;
+	} stages[] = {
+		{ Profiler::EVENTS, 64, 64, 255 },
+		{ Profiler::UPDATE, 64, 255, 64 },
+		{ Profiler::RENDER, 255, 255, 64 },
+		{ Profiler::PRESENT, 255, 64, 64 },
+	};
+
+	const Profiler& profiler = GetProfiler();
+	const int bottom = kScreenHeightPixels;
+
+	auto height = [](float milliseconds) {
+		return std::min(kGraphHeight, (int)(milliseconds * kPixelsPerMs + 0.5f));
+	};
+
+	for (size_t age = 0; age < profiler.GetNumFrames() && age < (size_t)kScreenWidthPixels; age++) {
+		const int x = kScreenWidthPixels - 1 - age;
+
+		painter_.FillRect(SDL2pp::Rect(x, bottom - height(profiler.GetTime(Profiler::FRAME, age)), 1, kGraphHeight), 96, 96, 96);
+
+		float total = 0.0f;
+		for (const auto& stage : stages) {
+			const int top = height(total + profiler.GetTime(stage.timer, age));
+			const int base = height(total);
+			if (top > base)
+				painter_.FillRect(SDL2pp::Rect(x, bottom - top, 1, top - base), stage.r, stage.g, stage.b);
+			total += profiler.GetTime(stage.timer, age);
 		}
+	}
+
+	const Profiler::Stats frame = profiler.GetStats(Profiler::FRAME);
+	painter_.FillRect(SDL2pp::Rect(0, bottom - height(frame.p50), kScreenWidthPixels, 1), 255, 255, 255);
+	painter_.FillRect(SDL2pp::Rect(0, bottom - height(frame.p99), kScreenWidthPixels, 1), 255, 128, 255);
+}
+
+void GameScene::Quit() {
+	if (!record_path_.empty())
+		recording_.Save(record_path_);
+
+	SetExit(true);
+}
+
+void GameScene::Rewind(unsigned int ticks) {
+	// oldest state is always kept
+	history_.DropNewest(std::min<size_t>(ticks, history_.GetSize() - 1));
+	history_.Get(0, snapshot_);
+	world_.LoadState(snapshot_);
+
+	// forget checkpoints reached later
+	while (checkpoints_.size() > 1 && checkpoints_.back().ticks > world_.GetTicks())
+		checkpoints_.pop_back();
+
+	// recording follows the timeline which ends up being played
+	if (!record_path_.empty())
+		recording_.Truncate(world_.GetTicks());
+}
+
+void GameScene::Respawn() {
+	const Checkpoint& checkpoint = checkpoints_.back();
+
+	world_.LoadState(checkpoint.state);
+
+	history_.Clear();
+	history_.Push(checkpoint.state);
 
-		if (result & (int)CollisionState::LEFT && object.xvel < 0.0f)
-			object.xvel = 0.0f;
-		if (result & (int)CollisionState::RIGHT && object.xvel > 0.0f)
-			object.xvel = 0.0f;
-		if (result & (int)CollisionState::TOP && object.yvel < 0.0f)
-			object.yvel = 0.0f;
-		if (result & (int)CollisionState::BOTTOM && object.yvel > 0.0f)
-			object.yvel = 0.0f;
-
-		object.x += object.xvel * delta_time / num_steps;
-		object.y += object.yvel * delta_time / num_steps;
+	if (!record_path_.empty())
+		recording_.Truncate(world_.GetTicks());
+}
+
+void GameScene::Death(const std::string& message) {
+	// replays must end the way they were recorded
+	if (replaying_) {
+		std::cerr << "Game over (" << message << ")" << std::endl;
+		Quit();
+		return;
 	}
 
-	return result;
+	std::cerr << "You died (" << message << "), respawning" << std::endl;
+	Respawn();
 }
 
-int GameScene::CheckCollisionWithStatic(const SDL2pp::Rect& rect) const {
-	// collision rectangle
-	const SDL2pp::Rect coll_rect { rect.x - 1, rect.y - 1, rect.w + 2, rect.h + 2 };
-
-	// side collision rectangles
-	const SDL2pp::Rect left_rect { rect.x - 1, rect.y, 1, rect.h };
-	const SDL2pp::Rect right_rect { rect.x + rect.w, rect.y, 1, rect.h };
-	const SDL2pp::Rect top_rect { rect.x, rect.y - 1, rect.w, 1 };
-	const SDL2pp::Rect bottom_rect { rect.x, rect.y + rect.h, rect.w, 1 };
-
-	int result = 0;
-
-	// this + std::max() in the loops below to avoid signed math
-	// problems with negative tile coordinates
-	if (coll_rect.GetX() < 0)
-		result |= (int)CollisionState::LEFT;
-	if (coll_rect.GetY() < 0)
-		result |= (int)CollisionState::TOP;
-
-	for (int y = std::max(coll_rect.y / kTileSize, 0); y <= coll_rect.GetY2() / kTileSize; y++) {
-		for (int x = std::max(coll_rect.x / kTileSize, 0); x <= coll_rect.GetX2() / kTileSize; x++) {
-			const auto& tile = game_map_.GetTile(x, y);
-			for (auto& coll_rect : tile.GetCollisionMap()) {
-				SDL2pp::Rect ground_rect = coll_rect + SDL2pp::Point(x * kTileSize, y * kTileSize);
-
-				int tile_result = 0;
-				if (top_rect.Intersects(ground_rect))
-					tile_result |= (int)CollisionState::TOP;
-				if (left_rect.Intersects(ground_rect))
-					tile_result |= (int)CollisionState::LEFT;
-				if (bottom_rect.Intersects(ground_rect))
-					tile_result |= (int)CollisionState::BOTTOM;
-				if (right_rect.Intersects(ground_rect))
-					tile_result |= (int)CollisionState::RIGHT;
-
-				if (tile_result && tile.IsDeadly())
-					tile_result |= (int)CollisionState::DEADLY;
-
-				result |= tile_result;
-			}
+void GameScene::CheckReload() {
+	if (!watcher_)
+		return;
+
+	for (const auto& path : watcher_->Poll())
+		if (std::find(changed_paths_.begin(), changed_paths_.end(), path) == changed_paths_.end())
+			changed_paths_.push_back(path);
+
+	if (reloader_ && reloader_->IsDone()) {
+		try {
+			SwapAssets(reloader_->Take());
+		} catch (std::exception& e) {
+			// keep playing with what we have
+			std::cerr << "Cannot reload assets: " << e.what() << std::endl;
 		}
+		reloader_.reset();
 	}
 
-	return result;
+	// files changed during reloading are picked by the next one
+	if (!reloader_ && !changed_paths_.empty()) {
+		// only changed files are reparsed, the rest comes
+		// from the cache as is
+		for (const auto& path : changed_paths_)
+			GetAssetCache().Invalidate(path);
+		changed_paths_.clear();
+
+		reloader_.reset(new AssetLoader(GetAssetCache(), map_path_, tiles_path_));
+	}
 }
 
-void GameScene::Death(const std::string& message) {
-	std::cerr << "Game over (" << message << ")" << std::endl;
-	SetExit(true);
+void GameScene::SwapAssets(AssetLoader::Assets assets) {
+	// map goes first, as the world rejects unusable maps by
+	// throwing, in which case nothing is swapped
+	if (assets.map != game_map_) {
+		const bool state_kept = world_.SetMap(*assets.map);
+
+		map_streamer_.SetMap(*assets.map);
+		game_map_ = assets.map;
+
+		if (!state_kept) {
+			// objects changed, so saved states no longer fit
+			world_.SaveState(snapshot_);
+			history_.Clear();
+			history_.Push(snapshot_);
+			checkpoints_.clear();
+			checkpoints_.emplace_back(Checkpoint{world_.GetTicks(), world_.GetCheckpoint(), snapshot_});
+		}
+	}
+
+	if (assets.atlas != atlas_) {
+		painter_.SetAtlas(*assets.atlas, assets.atlas_texture);
+		atlas_ = assets.atlas;
+	}
+
+	ground_cache_.Clear();
+
+	std::cerr << "Assets reloaded" << std::endl;
 }
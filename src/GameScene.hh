@@ -20,103 +20,105 @@
 #ifndef GAMESCENE_HH
 #define GAMESCENE_HH
 
-#include <array>
-
-#include <SDL2pp/Texture.hh>
+#include <memory>
 
+#include "AssetLoader.hh"
+#include "FileWatcher.hh"
 #include "GameMap.hh"
+#include "GameWorld.hh"
+#include "InputTrace.hh"
 #include "LowresPainter.hh"
+#include "MapStreamer.hh"
 #include "Scene.hh"
+#include "ScreenCache.hh"
+#include "SnapshotRing.hh"
 
 class GameScene : public Scene {
 private:
-	SDL2pp::Texture tiles_;
-	GameMap game_map_;
+	struct Checkpoint {
+		unsigned int ticks;
+		int index; // see GameWorld::GetCheckpoint()
+		std::vector<char> state;
+	};
+
+private:
+	// shared with the asset cache
+	std::shared_ptr<const GameMap> game_map_;
+	std::shared_ptr<const SoftwareRasterizer> atlas_;
+	MapStreamer map_streamer_;
 
 	LowresPainter painter_;
+	ScreenCache ground_cache_;
 
-private:
-	struct DynamicObject {
-		float x;
-		float y;
-		float xvel;
-		float yvel;
-
-		const GameMap::MetaTileInfo& metatile;
-
-		DynamicObject(const GameMap::MetaTileInfo& metatile)
-			: x(0.0f), y(0.0f),
-			  xvel(0.0f), yvel(0.0f),
-			  metatile(metatile) {
-		}
-
-		void Place(const SDL2pp::Rect& place) {
-			x = place.x;
-			y = place.y;
-		}
-
-		SDL2pp::Point GetPoint() const {
-			return SDL2pp::Point((int)x, (int)y);
-		}
-
-		SDL2pp::Point GetAnchor() const {
-			return GetPoint() + SDL2pp::Point(metatile.source_rect.w / 2, metatile.source_rect.h - 1);
-		}
-
-		const SDL2pp::Rect& GetSrcRect() const {
-			return metatile.source_rect;
-		}
-
-		template <class Processor>
-		void ForeachCollisionRect(Processor processor) const {
-			for (const auto& rect : metatile.collision_map)
-				processor(rect + GetPoint());
-		}
-	};
+	GameWorld world_;
 
-private:
-	unsigned int prev_frame_time_;
+	// state of control keys
+	int control_flags_ = 0;
 
-	DynamicObject player_;
-	bool player_facing_right_ = true;
+	bool show_profiler_ = false;
+
+	// world state of recent ticks, for rewinding
+	SnapshotRing history_;
+	std::vector<char> snapshot_;
+	bool rewinding_ = false;
+
+	// world states at start and at each checkpoint reached in
+	// current timeline, to respawn from on death without
+	// reloading anything
+	std::vector<Checkpoint> checkpoints_;
+
+	// controls of every tick are recorded into recording_, or
+	// taken from replay_ instead of keyboard; both are checked
+	// against by state hashes
+	std::string record_path_;
+	InputTrace recording_;
+
+	bool replaying_;
+	bool diverged_ = false;
+	InputTrace replay_;
+	InputTrace::Reader replay_reader_;
+
+	// edited map and tileset are reloaded in background, see
+	// CheckReload(); only when not recording or replaying
+	std::string map_path_;
+	std::string tiles_path_;
+	std::unique_ptr<FileWatcher> watcher_;
+	std::unique_ptr<AssetLoader> reloader_;
+	std::vector<std::string> changed_paths_;
 
-	enum class ControlFlags {
-		LEFT = 0x01,
-		RIGHT = 0x02,
-		UP = 0x04,
-	};
+private:
+	static SDL2pp::Point GetScreenOffset(const SDL2pp::Point& player_anchor);
 
-	enum class CollisionState {
-		NONE = 0,
-		LEFT = 0x01,
-		RIGHT = 0x02,
-		TOP = 0x04,
-		BOTTOM = 0x08,
+	// Saves recording, if any, and exits
+	void Quit();
 
-		DEADLY = 0x100,
-	};
+	// Returns world to the state given number of ticks ago, or
+	// to the oldest one remembered
+	void Rewind(unsigned int ticks);
 
-	int control_flags_ = 0;
+	// Returns world to the state at last checkpoint
+	void Respawn();
 
-	// misc. objects
-	DynamicObject lander_;
+	// Starts reloading of changed assets and swaps in those
+	// reloaded
+	void CheckReload();
+	void SwapAssets(AssetLoader::Assets assets);
 
 public:
-	GameScene(Application& app);
+	// Uses assets loaded by AssetLoader; empty paths
+	// disable recording and replay
+	GameScene(Application& app, AssetLoader::Assets assets, LowresPainter::Backend backend = LowresPainter::Backend::ACCELERATED, const std::string& record_path = "", const std::string& replay_path = "");
 
 	virtual void ProcessEvent(const SDL_Event& event) override;
-	virtual void Update() override;
-	virtual void Render() override;
-
-	void UpdatePlayer(float delta_time);
+	virtual void Update(float delta_time) override;
+	virtual void Render(float alpha) override;
 
 	void RenderGround(const SDL2pp::Point& offset);
-	void RenderPlayer(const SDL2pp::Point& offset);
-	void RenderLander(const SDL2pp::Point& offset);
-
-	int MoveWithCollision(DynamicObject& object, float delta_time) const;
-
-	int CheckCollisionWithStatic(const SDL2pp::Rect& rect) const;
+	void RenderGroundTiles(const SDL2pp::Point& offset);
+	void RenderPlayer(const SDL2pp::Point& offset, float alpha);
+	void RenderLander(const SDL2pp::Point& offset, float alpha);
+	void RenderMonsters(const SDL2pp::Point& offset, float alpha);
+	void RenderProfiler();
 
 	void Death(const std::string& message);
 };
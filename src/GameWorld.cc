@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GameWorld.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "Constants.hh"
+#include "Physics.hh"
+#include "Profiler.hh"
+
+// mouth monsters chew through frames 0, 1, 2, 1
+static const unsigned int kMonsterFrameTicks = 15;
+static const unsigned int kMonsterAnimation[] = { 0, 1, 2, 1 };
+static const unsigned int kMonsterAnimationLength = sizeof(kMonsterAnimation) / sizeof(kMonsterAnimation[0]);
+
+// layout of GameWorld::SaveState() output: this header, then
+// arrays of ObjectPool fields, then text of death reason
+struct StateHeader {
+	uint32_t ticks;
+	int32_t control_flags;
+	uint32_t num_objects;
+	int32_t checkpoint;
+	uint16_t death_reason_length;
+	uint8_t player_facing_right;
+	uint8_t dead;
+};
+
+// monsters are expected to fit into a grid cell
+static const int kMonsterGridCellSize = 64;
+
+GameWorld::GameWorld(const GameMap& game_map)
+	: game_map_(&game_map),
+	  monster_grid_(game_map_->GetWidth() * kTileSize, game_map_->GetHeight() * kTileSize, kMonsterGridCellSize),
+	  checkpoints_(game_map_->GetObjects(GameMap::CHECKPOINT)) {
+
+	player_ = objects_.Add(objects_.AddMetaTile(game_map_->GetMetaTileInfo("player")), game_map_->GetObject(GameMap::PLAYER_START).rect, 1.0f);
+	lander_ = objects_.Add(objects_.AddMetaTile(game_map_->GetMetaTileInfo("lander")), game_map_->GetObject(GameMap::LANDER).rect, 0.0f);
+
+	const ArrayView<GameMap::Object> monsters = game_map_->GetObjects(GameMap::MOUTH_MONSTER);
+	if (!monsters.empty()) {
+		monster_frames_ = objects_.AddMetaTile(game_map_->GetMetaTileInfo("mouth_monster_0"));
+		objects_.AddMetaTile(game_map_->GetMetaTileInfo("mouth_monster_1"));
+		objects_.AddMetaTile(game_map_->GetMetaTileInfo("mouth_monster_2"));
+	}
+
+	first_monster_ = objects_.GetSize();
+	num_monsters_ = monsters.size();
+	for (const auto& object : monsters)
+		objects_.Add(monster_frames_, object.rect, 0.0f);
+
+	UpdateMonsters();
+}
+
+bool GameWorld::SetMap(const GameMap& game_map) {
+	const ArrayView<GameMap::Object>& old_objects = game_map_->GetObjects();
+	const ArrayView<GameMap::Object>& new_objects = game_map.GetObjects();
+
+	const bool same_objects = old_objects.size() == new_objects.size() &&
+		std::equal(old_objects.begin(), old_objects.end(), new_objects.begin(), [](const GameMap::Object& a, const GameMap::Object& b) {
+				return a.type == b.type && a.rect == b.rect;
+			});
+
+	// everything which may throw (such as missing objects or
+	// metatiles in the new map) is done on a separate world, so
+	// this one is left intact on failure; metatiles refer to map
+	// data, so objects are placed anew even if they are the same
+	GameWorld world(game_map);
+
+	if (same_objects) {
+		std::vector<char> state;
+		SaveState(state);
+		world.LoadState(state);
+	} else {
+		// player stays where it was, everything else starts over
+		world.objects_.x[world.player_] = objects_.x[player_];
+		world.objects_.y[world.player_] = objects_.y[player_];
+		world.objects_.xvel[world.player_] = objects_.xvel[player_];
+		world.objects_.yvel[world.player_] = objects_.yvel[player_];
+		world.objects_.prev_x[world.player_] = objects_.prev_x[player_];
+		world.objects_.prev_y[world.player_] = objects_.prev_y[player_];
+
+		world.player_facing_right_ = player_facing_right_;
+		world.control_flags_ = control_flags_;
+		world.ticks_ = ticks_;
+		world.dead_ = dead_;
+		world.death_reason_ = death_reason_;
+	}
+
+	*this = std::move(world);
+
+	return same_objects;
+}
+
+void GameWorld::SetControlFlags(int flags) {
+	// player turns to the direction of last pressed key
+	int pressed = flags & ~control_flags_;
+	if (pressed & (int)ControlFlags::LEFT)
+		player_facing_right_ = false;
+	if (pressed & (int)ControlFlags::RIGHT)
+		player_facing_right_ = true;
+
+	control_flags_ = flags;
+}
+
+int GameWorld::GetControlFlags() const {
+	return control_flags_;
+}
+
+void GameWorld::Update(float delta_time) {
+	if (dead_)
+		return;
+
+	objects_.BeginTick();
+	ticks_++;
+
+	// batch passes over all objects
+	objects_.ApplyGravity(kGForce * delta_time);
+	UpdateMonsters();
+
+	const float player_fall_speed = objects_.yvel[player_];
+
+	// narrowphase is only needed for objects in motion
+	for (ObjectPool::Index index = 0; index < objects_.GetSize(); index++) {
+		if (objects_.xvel[index] != 0.0f || objects_.yvel[index] != 0.0f)
+			objects_.collision[index] = MoveWithCollision(objects_, index, delta_time);
+		else
+			objects_.collision[index] = (int)CollisionState::NONE;
+	}
+
+	UpdatePlayer(delta_time, player_fall_speed);
+
+	if (!dead_ && IsTouchingMonster(player_))
+		Death("you've been eaten");
+}
+
+void GameWorld::UpdatePlayer(float delta_time, float fall_speed) {
+	float& xvel = objects_.xvel[player_];
+	float& yvel = objects_.yvel[player_];
+
+	int moveresult = objects_.collision[player_];
+
+	// Handle some death conditions
+	if (moveresult & (int)CollisionState::DEADLY) {
+		Death("you've touched something deadly");
+		return;
+	}
+	if (moveresult & (int)CollisionState::BOTTOM && fall_speed >= kFatalSpeed) {
+		Death("you fell to your death");
+		return;
+	}
+
+	// Process player controls
+	bool on_ground = (moveresult & (int)CollisionState::BOTTOM) && yvel >= 0.0f;
+	float control_rate = on_ground ? 1.0 : kAirControlRate;
+
+	// only standing in a checkpoint counts, so player is never
+	// respawned in midair
+	if (on_ground)
+		UpdateCheckpoint();
+
+	// Move left/right
+	if (control_flags_ & (int)ControlFlags::LEFT && xvel >= -kWalkMaxSpeed) {
+		xvel = std::max(-kWalkMaxSpeed, xvel - control_rate * kWalkAccel * delta_time);
+	} else if (control_flags_ & (int)ControlFlags::RIGHT && xvel <= kWalkMaxSpeed) {
+		xvel = std::min(kWalkMaxSpeed, xvel + control_rate * kWalkAccel * delta_time);
+	} else if (on_ground) { // decelerate when on ground
+		if (xvel > 0)
+			xvel -= std::min(xvel, kWalkDecel * delta_time);
+		if (xvel < 0)
+			xvel += std::min(-xvel, kWalkDecel * delta_time);
+	}
+
+	// Jump
+	if (on_ground && control_flags_ & (int)ControlFlags::UP)
+		yvel -= kJumpImpulse;
+}
+
+void GameWorld::UpdateMonsters() {
+	// monsters are out of phase with each other
+	const unsigned int step = ticks_ / kMonsterFrameTicks;
+	for (unsigned int monster = 0; monster < num_monsters_; monster++)
+		objects_.metatile[first_monster_ + monster] = monster_frames_ + kMonsterAnimation[(step + monster) % kMonsterAnimationLength];
+
+	monster_grid_.Build(num_monsters_, [this](unsigned int monster) {
+			return objects_.GetPoint(first_monster_ + monster);
+		});
+}
+
+void GameWorld::UpdateCheckpoint() {
+	for (size_t checkpoint = 0; checkpoint < checkpoints_.size(); checkpoint++) {
+		objects_.ForeachCollisionRect(player_, [this, checkpoint](const SDL2pp::Rect& rect) {
+				if (rect.Intersects(checkpoints_[checkpoint].rect))
+					checkpoint_ = checkpoint;
+			});
+	}
+}
+
+bool GameWorld::IsTouchingMonster(ObjectPool::Index index) const {
+	bool touching = false;
+	objects_.ForeachCollisionRect(index, [&touching, this](const SDL2pp::Rect& rect) {
+			monster_grid_.Query(rect, [&touching, &rect, this](unsigned int monster) {
+					const ObjectPool::Index index = first_monster_ + monster;
+					if (rect.Intersects(SDL2pp::Rect(objects_.GetPoint(index), objects_.GetSrcRect(index).GetSize())))
+						touching = true;
+				});
+		});
+	return touching;
+}
+
+int GameWorld::MoveWithCollision(ObjectPool& objects, ObjectPool::Index index, float delta_time) const {
+	float& x = objects.x[index];
+	float& y = objects.y[index];
+	float& xvel = objects.xvel[index];
+	float& yvel = objects.yvel[index];
+
+	// move in 1 pixel steps, checking collisions on each step
+	int num_steps = 1 + (int)(std::max(std::abs(xvel), std::abs(yvel)) * delta_time);
+
+	Profiler::Count(Profiler::MOVE_STEPS, num_steps);
+
+	// if there's nothing to collide with in the whole area the
+	// object may sweep through during this move, all steps are
+	// known to be collision free and may skip collision checks
+	const bool sweep_free = IsSweepFree(objects, index, delta_time);
+
+	// otherwise, as collision state only depends on integer
+	// position of the object, it is only rechecked when the
+	// object crosses a pixel boundary
+	bool probed = false;
+	SDL2pp::Point probed_point;
+	int probed_result = (int)CollisionState::NONE;
+
+	int result = (int)CollisionState::NONE;
+	for (int step = 0; step < num_steps && (xvel != 0.0f || yvel != 0.0f); step++) {
+		// try normal collision
+		const SDL2pp::Point point = objects.GetPoint(index);
+		if (!sweep_free && (!probed || point != probed_point)) {
+			probed_result = (int)CollisionState::NONE;
+			objects.ForeachCollisionRect(index, [&probed_result, this](const SDL2pp::Rect& rect){
+					probed_result |= CheckCollisionWithStatic(rect);
+				});
+			probed_point = point;
+			probed = true;
+		}
+
+		result = probed_result;
+
+		// if applicable, try autostep
+		if (result & (int)CollisionState::BOTTOM &&
+				((result & (int)CollisionState::LEFT && xvel < 0.0f) ||
+				(result & (int)CollisionState::RIGHT && xvel > 0.0f))) {
+			for (int autostep = 1; autostep <= kAutoStepAmount; autostep++) {
+				int tryresult = (int)CollisionState::NONE;
+
+				objects.ForeachCollisionRect(index, [&tryresult, autostep, this](const SDL2pp::Rect& rect){
+						tryresult |= CheckCollisionWithStatic(rect - SDL2pp::Point(0, autostep));
+					});
+
+				if (tryresult == (int)CollisionState::NONE) {
+					result = tryresult;
+					y -= autostep;
+					break;
+				}
+			}
+		}
+
+		if (result & (int)CollisionState::LEFT && xvel < 0.0f)
+			xvel = 0.0f;
+		if (result & (int)CollisionState::RIGHT && xvel > 0.0f)
+			xvel = 0.0f;
+		if (result & (int)CollisionState::TOP && yvel < 0.0f)
+			yvel = 0.0f;
+		if (result & (int)CollisionState::BOTTOM && yvel > 0.0f)
+			yvel = 0.0f;
+
+		x += xvel * delta_time / num_steps;
+		y += yvel * delta_time / num_steps;
+	}
+
+	return result;
+}
+
+bool GameWorld::IsSweepFree(const ObjectPool& objects, ObjectPool::Index index, float delta_time) const {
+	// bounding box of all integer positions object may take while
+	// moving; 1 pixel margin covers rounding of per-step movement
+	const SDL2pp::Point from = objects.GetPoint(index);
+	const SDL2pp::Point to((int)(objects.x[index] + objects.xvel[index] * delta_time), (int)(objects.y[index] + objects.yvel[index] * delta_time));
+
+	const SDL2pp::Point min(std::min(from.x, to.x) - 1, std::min(from.y, to.y) - 1);
+	const SDL2pp::Point max(std::max(from.x, to.x) + 1, std::max(from.y, to.y) + 1);
+
+	bool free = true;
+	objects.ForeachCollisionRect(index, [&free, &min, &max, &from, this](const SDL2pp::Rect& rect){
+			// rect swept over the bounding box, plus 1 pixel wide
+			// border checked by CheckCollisionWithStatic
+			const SDL2pp::Rect swept(
+					rect.x - from.x + min.x - 1,
+					rect.y - from.y + min.y - 1,
+					rect.w + max.x - min.x + 2,
+					rect.h + max.y - min.y + 2
+				);
+
+			// map edges always produce collision
+			if (swept.x < 0 || swept.y < 0 || game_map_->ProbeRect(swept) != 0)
+				free = false;
+		});
+
+	return free;
+}
+
+int GameWorld::CheckCollisionWithStatic(const SDL2pp::Rect& rect) const {
+	Profiler::Count(Profiler::COLLISION_CHECKS);
+
+	int result = 0;
+
+	// map edges
+	if (rect.x - 1 < 0)
+		result |= (int)CollisionState::LEFT;
+	if (rect.y - 1 < 0)
+		result |= (int)CollisionState::TOP;
+
+	// probe 1 pixel wide lines along each side of the rect
+	const int top = game_map_->ProbeRow(rect.x, rect.y - 1, rect.w);
+	const int left = game_map_->ProbeColumn(rect.x - 1, rect.y, rect.h);
+	const int bottom = game_map_->ProbeRow(rect.x, rect.y + rect.h, rect.w);
+	const int right = game_map_->ProbeColumn(rect.x + rect.w, rect.y, rect.h);
+
+	if (top & GameMap::PROBE_SOLID)
+		result |= (int)CollisionState::TOP;
+	if (left & GameMap::PROBE_SOLID)
+		result |= (int)CollisionState::LEFT;
+	if (bottom & GameMap::PROBE_SOLID)
+		result |= (int)CollisionState::BOTTOM;
+	if (right & GameMap::PROBE_SOLID)
+		result |= (int)CollisionState::RIGHT;
+
+	if ((top | left | bottom | right) & GameMap::PROBE_DEADLY)
+		result |= (int)CollisionState::DEADLY;
+
+	return result;
+}
+
+void GameWorld::Death(const std::string& reason) {
+	dead_ = true;
+	death_reason_ = reason;
+}
+
+const GameMap& GameWorld::GetMap() const {
+	return *game_map_;
+}
+
+const ObjectPool& GameWorld::GetObjects() const {
+	return objects_;
+}
+
+ObjectPool::Object GameWorld::GetPlayer() const {
+	return objects_.Get(player_);
+}
+
+ObjectPool::Object GameWorld::GetLander() const {
+	return objects_.Get(lander_);
+}
+
+bool GameWorld::IsPlayerFacingRight() const {
+	return player_facing_right_;
+}
+
+int GameWorld::GetCheckpoint() const {
+	return checkpoint_;
+}
+
+bool GameWorld::IsDead() const {
+	return dead_;
+}
+
+const std::string& GameWorld::GetDeathReason() const {
+	return death_reason_;
+}
+
+unsigned int GameWorld::GetTicks() const {
+	return ticks_;
+}
+
+uint64_t GameWorld::GetStateHash() const {
+	// FNV-1a over exact bit patterns of state values
+	uint64_t hash = 14695981039346656037ULL;
+	auto feed = [&hash](const void* data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= static_cast<const unsigned char*>(data)[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	const float values[] = {
+		objects_.x[player_],
+		objects_.y[player_],
+		objects_.xvel[player_],
+		objects_.yvel[player_],
+	};
+	const uint8_t flags[] = { player_facing_right_, dead_ };
+
+	feed(values, sizeof(values));
+	feed(flags, sizeof(flags));
+
+	return hash;
+}
+
+void GameWorld::SaveState(std::vector<char>& state) const {
+	const size_t num_objects = objects_.GetSize();
+	const size_t fields_size = num_objects * (6 * sizeof(float) + sizeof(unsigned int) + sizeof(int));
+
+	StateHeader header;
+	header.ticks = ticks_;
+	header.control_flags = control_flags_;
+	header.num_objects = num_objects;
+	header.checkpoint = checkpoint_;
+	header.death_reason_length = death_reason_.size();
+	header.player_facing_right = player_facing_right_;
+	header.dead = dead_;
+
+	state.resize(sizeof(header) + fields_size + death_reason_.size());
+
+	char* out = state.data();
+	auto write = [&out](const void* data, size_t size) {
+		std::memcpy(out, data, size);
+		out += size;
+	};
+
+	write(&header, sizeof(header));
+	write(objects_.x.data(), num_objects * sizeof(float));
+	write(objects_.y.data(), num_objects * sizeof(float));
+	write(objects_.xvel.data(), num_objects * sizeof(float));
+	write(objects_.yvel.data(), num_objects * sizeof(float));
+	write(objects_.prev_x.data(), num_objects * sizeof(float));
+	write(objects_.prev_y.data(), num_objects * sizeof(float));
+	write(objects_.metatile.data(), num_objects * sizeof(unsigned int));
+	write(objects_.collision.data(), num_objects * sizeof(int));
+	write(death_reason_.data(), death_reason_.size());
+}
+
+void GameWorld::LoadState(const std::vector<char>& state) {
+	const size_t num_objects = objects_.GetSize();
+	const size_t fields_size = num_objects * (6 * sizeof(float) + sizeof(unsigned int) + sizeof(int));
+
+	StateHeader header;
+	if (state.size() < sizeof(header))
+		throw std::runtime_error("cannot load world state: truncated");
+
+	std::memcpy(&header, state.data(), sizeof(header));
+
+	if (header.num_objects != num_objects || state.size() != sizeof(header) + fields_size + header.death_reason_length)
+		throw std::runtime_error("cannot load world state: does not match the world");
+
+	if (header.checkpoint < -1 || header.checkpoint >= (int)checkpoints_.size())
+		throw std::runtime_error("cannot load world state: bad checkpoint");
+
+	const char* in = state.data() + sizeof(header);
+	auto read = [&in](void* data, size_t size) {
+		std::memcpy(data, in, size);
+		in += size;
+	};
+
+	read(objects_.x.data(), num_objects * sizeof(float));
+	read(objects_.y.data(), num_objects * sizeof(float));
+	read(objects_.xvel.data(), num_objects * sizeof(float));
+	read(objects_.yvel.data(), num_objects * sizeof(float));
+	read(objects_.prev_x.data(), num_objects * sizeof(float));
+	read(objects_.prev_y.data(), num_objects * sizeof(float));
+	read(objects_.metatile.data(), num_objects * sizeof(unsigned int));
+	read(objects_.collision.data(), num_objects * sizeof(int));
+
+	death_reason_.assign(in, header.death_reason_length);
+
+	ticks_ = header.ticks;
+	control_flags_ = header.control_flags;
+	checkpoint_ = header.checkpoint;
+	player_facing_right_ = header.player_facing_right;
+	dead_ = header.dead;
+
+	// derived from positions
+	UpdateMonsters();
+}
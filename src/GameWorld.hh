@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GAMEWORLD_HH
+#define GAMEWORLD_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SDL2pp/Point.hh>
+#include <SDL2pp/Rect.hh>
+
+#include "GameMap.hh"
+#include "ObjectPool.hh"
+#include "SpatialGrid.hh"
+
+// Mutable state of a game in progress and its simulation
+//
+// Doesn't depend on any rendering facilities, so it may be run
+// headless; the map is not modified and may be shared between
+// any number of worlds
+class GameWorld {
+public:
+	enum class ControlFlags {
+		LEFT = 0x01,
+		RIGHT = 0x02,
+		UP = 0x04,
+	};
+
+	enum class CollisionState {
+		NONE = 0,
+		LEFT = 0x01,
+		RIGHT = 0x02,
+		TOP = 0x04,
+		BOTTOM = 0x08,
+
+		DEADLY = 0x100,
+	};
+
+private:
+	const GameMap* game_map_;
+
+	// all dynamic objects: player, lander and monsters
+	ObjectPool objects_;
+
+	ObjectPool::Index player_;
+	bool player_facing_right_ = true;
+
+	int control_flags_ = 0;
+
+	// misc. objects
+	ObjectPool::Index lander_;
+
+	// monsters occupy a contiguous range of objects, with
+	// broadphase over their positions rebuilt every tick
+	ObjectPool::Index first_monster_;
+	unsigned int num_monsters_ = 0;
+	unsigned int monster_frames_ = 0; // first animation frame metatile
+	SpatialGrid monster_grid_;
+	unsigned int ticks_ = 0;
+
+	// last checkpoint player has stood in, index into checkpoints_
+	ArrayView<GameMap::Object> checkpoints_;
+	int checkpoint_ = -1;
+
+	bool dead_ = false;
+	std::string death_reason_;
+
+public:
+	GameWorld(const GameMap& game_map);
+
+	// Switches to another version of the map, e.g. one reloaded
+	// after editing; old map must still be alive during the call.
+	// If the map has the same objects, all state is kept and true
+	// is returned, otherwise objects are placed anew with player
+	// staying where it was. If the map is not usable (e.g. lacks
+	// the player), throws and leaves the world unchanged
+	bool SetMap(const GameMap& game_map);
+
+	void SetControlFlags(int flags);
+	int GetControlFlags() const;
+
+	// Advance world by a single tick
+	void Update(float delta_time);
+
+	// fall_speed is vertical velocity before the move
+	void UpdatePlayer(float delta_time, float fall_speed);
+	void UpdateMonsters();
+	void UpdateCheckpoint();
+
+	bool IsTouchingMonster(ObjectPool::Index index) const;
+
+	int MoveWithCollision(ObjectPool& objects, ObjectPool::Index index, float delta_time) const;
+	bool IsSweepFree(const ObjectPool& objects, ObjectPool::Index index, float delta_time) const;
+
+	int CheckCollisionWithStatic(const SDL2pp::Rect& rect) const;
+
+	void Death(const std::string& reason);
+
+	const GameMap& GetMap() const;
+	const ObjectPool& GetObjects() const;
+	ObjectPool::Object GetPlayer() const;
+	ObjectPool::Object GetLander() const;
+
+	// Calls processor(monster) for monsters which may be visible
+	// in given area
+	template <class Processor>
+	void ForeachMonster(const SDL2pp::Rect& area, Processor processor) const {
+		monster_grid_.Query(area, [this, &processor](unsigned int index) {
+				processor(objects_.Get(first_monster_ + index));
+			});
+	}
+
+	bool IsPlayerFacingRight() const;
+
+	// Last checkpoint reached, or -1; see GameMap::CHECKPOINT
+	int GetCheckpoint() const;
+
+	bool IsDead() const;
+	const std::string& GetDeathReason() const;
+
+	// Number of ticks simulated
+	unsigned int GetTicks() const;
+
+	// Hash of player state, for checking that simulation is
+	// reproducible; see InputTrace
+	uint64_t GetStateHash() const;
+
+	// All mutable state as plain bytes, which may be stored (see
+	// SnapshotRing) and loaded back into a world of the same map
+	void SaveState(std::vector<char>& state) const;
+	void LoadState(const std::vector<char>& state);
+};
+
+#endif // GAMEWORLD_HH
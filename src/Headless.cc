@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BatchRunner.hh"
+#include "GameMap.hh"
+#include "InputTrace.hh"
+
+// Runs recorded input traces against game logic without any
+// window or renderer, as fast as possible, using all CPU cores
+
+static void Usage(const char* progname) {
+	std::cerr << "Usage: " << progname << " [-m map.tmx] [-n repeat] [-j threads] [-v] [-o output] trace..." << std::endl;
+	std::cerr << "  -v  verify state hashes stored in traces, fail on divergence" << std::endl;
+	std::cerr << "  -o  save single trace along with state hashes of this run" << std::endl;
+}
+
+int main(int argc, char** argv) try {
+	std::string map_path = DATADIR "/maps/planetonomy.tmx";
+	int repeat = 1;
+	int num_threads = 0;
+	bool verify = false;
+	std::string output_path;
+	std::vector<std::string> trace_paths;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			map_path = argv[++i];
+		} else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			repeat = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			num_threads = std::atoi(argv[++i]);
+		} else if (std::strcmp(argv[i], "-v") == 0) {
+			verify = true;
+		} else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output_path = argv[++i];
+		} else if (argv[i][0] == '-') {
+			Usage(argv[0]);
+			return 1;
+		} else {
+			trace_paths.emplace_back(argv[i]);
+		}
+	}
+
+	if (trace_paths.empty() || repeat < 1 || num_threads < 0 || (!output_path.empty() && trace_paths.size() != 1)) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	const GameMap map(map_path);
+
+	std::vector<InputTrace> traces;
+	for (const auto& path : trace_paths)
+		traces.emplace_back(path);
+
+	// every repetition is a separate simulation
+	std::vector<const InputTrace*> jobs;
+	for (int iteration = 0; iteration < repeat; iteration++)
+		for (const auto& trace : traces)
+			jobs.push_back(&trace);
+
+	BatchRunner runner(map, num_threads);
+
+	auto start_time = std::chrono::steady_clock::now();
+	auto results = runner.Run(jobs);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+	unsigned long total_ticks = 0;
+	for (const auto& result : results)
+		total_ticks += result.ticks;
+
+	// results are deterministic, so report only first repetition
+	bool diverged = false;
+	for (size_t n = 0; n < traces.size(); n++) {
+		const auto& result = results[n];
+		std::cout << trace_paths[n] << ": " << result.ticks << " ticks, player at " << result.x << "," << result.y << ", ";
+		if (result.dead)
+			std::cout << "dead (" << result.death_reason << ")";
+		else
+			std::cout << "alive";
+		if (verify) {
+			if (traces[n].GetHashes().empty())
+				std::cout << ", no hashes to verify";
+			else if (result.divergence_tick != 0)
+				std::cout << ", DIVERGED at tick " << result.divergence_tick;
+			else
+				std::cout << ", verified";
+		}
+		std::cout << std::endl;
+
+		if (result.divergence_tick != 0)
+			diverged = true;
+	}
+
+	if (!output_path.empty()) {
+		InputTrace output = traces[0];
+		output.SetHashInterval(traces[0].GetHashInterval());
+		for (auto hash : results[0].hashes)
+			output.AppendHash(hash);
+		output.Save(output_path);
+	}
+
+	std::cout << "total: " << total_ticks << " ticks in " << elapsed.count() << " s on " << runner.GetNumThreads() << " thread(s)";
+	if (elapsed.count() > 0.0)
+		std::cout << " (" << (unsigned long)(total_ticks / elapsed.count()) << " ticks/s)";
+	std::cout << std::endl;
+
+	return verify && diverged ? 1 : 0;
+} catch (std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return 1;
+} catch (...) {
+	std::cerr << "Unknown error" << std::endl;
+	return 1;
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "InputTrace.hh"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "GameWorld.hh"
+
+static const char kMagic[8] = { 'P', 'L', 'N', 'T', 'T', 'R', 'C', '\0' };
+static const uint32_t kVersion = 1;
+
+constexpr unsigned int InputTrace::kDefaultHashInterval;
+
+InputTrace::Reader::Reader(const InputTrace& trace)
+	: trace_(trace) {
+}
+
+bool InputTrace::Reader::AtEnd() const {
+	return run_ == trace_.runs_.size();
+}
+
+int InputTrace::Reader::Next() {
+	const int flags = trace_.runs_[run_].flags;
+	if (++tick_ == trace_.runs_[run_].ticks) {
+		run_++;
+		tick_ = 0;
+	}
+	return flags;
+}
+
+InputTrace::InputTrace() {
+}
+
+InputTrace::InputTrace(const std::string& path) {
+	Load(path);
+}
+
+void InputTrace::Append(int flags, unsigned int ticks) {
+	if (ticks == 0)
+		return;
+
+	if (!runs_.empty() && runs_.back().flags == flags)
+		runs_.back().ticks += ticks;
+	else
+		runs_.emplace_back(Run{ticks, flags});
+}
+
+const std::vector<InputTrace::Run>& InputTrace::GetRuns() const {
+	return runs_;
+}
+
+unsigned long InputTrace::GetLength() const {
+	unsigned long length = 0;
+	for (const auto& run : runs_)
+		length += run.ticks;
+	return length;
+}
+
+void InputTrace::Truncate(unsigned long length) {
+	unsigned long kept = 0;
+	size_t run = 0;
+	while (run < runs_.size() && kept + runs_[run].ticks <= length)
+		kept += runs_[run++].ticks;
+
+	if (run < runs_.size() && kept < length)
+		runs_[run++].ticks = length - kept;
+
+	runs_.resize(run);
+
+	if (hashes_.size() > length / hash_interval_)
+		hashes_.resize(length / hash_interval_);
+}
+
+void InputTrace::SetHashInterval(unsigned int interval) {
+	if (interval == 0)
+		throw std::runtime_error("hash interval must be positive");
+
+	hash_interval_ = interval;
+	hashes_.clear();
+}
+
+unsigned int InputTrace::GetHashInterval() const {
+	return hash_interval_;
+}
+
+bool InputTrace::IsHashTick(unsigned long tick) const {
+	return tick > 0 && tick % hash_interval_ == 0;
+}
+
+void InputTrace::AppendHash(uint64_t hash) {
+	hashes_.push_back(hash);
+}
+
+const std::vector<uint64_t>& InputTrace::GetHashes() const {
+	return hashes_;
+}
+
+bool InputTrace::CheckHash(unsigned long tick, uint64_t hash) const {
+	if (!IsHashTick(tick) || tick / hash_interval_ > hashes_.size())
+		return true;
+
+	return hashes_[tick / hash_interval_ - 1] == hash;
+}
+
+void InputTrace::Load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("cannot open input trace " + path);
+
+	const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (file.bad())
+		throw std::runtime_error("cannot read input trace " + path);
+
+	runs_.clear();
+	hash_interval_ = kDefaultHashInterval;
+	hashes_.clear();
+
+	if (data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0)
+		LoadBinary(path, data);
+	else
+		LoadText(path, data);
+}
+
+void InputTrace::LoadBinary(const std::string& path, const std::string& data) {
+	size_t pos = sizeof(kMagic);
+
+	auto read_byte = [&]() -> uint8_t {
+		if (pos >= data.size())
+			throw std::runtime_error("cannot parse input trace " + path + ": unexpected end of file");
+		return data[pos++];
+	};
+
+	auto read_le = [&](int bytes) {
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; i++)
+			value |= (uint64_t)read_byte() << (i * 8);
+		return value;
+	};
+
+	auto read_leb128 = [&]() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			uint8_t byte = read_byte();
+			value |= (uint64_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		throw std::runtime_error("cannot parse input trace " + path + ": bad run length");
+	};
+
+	if (read_le(4) != kVersion)
+		throw std::runtime_error("cannot load input trace " + path + ": unsupported version");
+
+	const uint64_t hash_interval = read_le(4);
+	const uint64_t num_runs = read_le(4);
+	const uint64_t num_hashes = read_le(4);
+
+	if (hash_interval == 0)
+		throw std::runtime_error("cannot parse input trace " + path + ": bad hash interval");
+
+	hash_interval_ = hash_interval;
+
+	for (uint64_t run = 0; run < num_runs; run++) {
+		const int flags = read_byte();
+		const uint64_t ticks = read_leb128();
+		if (ticks > UINT32_MAX)
+			throw std::runtime_error("cannot parse input trace " + path + ": bad run length");
+		Append(flags, ticks);
+	}
+
+	for (uint64_t hash = 0; hash < num_hashes; hash++)
+		hashes_.push_back(read_le(8));
+
+	if (pos != data.size())
+		throw std::runtime_error("cannot parse input trace " + path + ": garbage at end of file");
+}
+
+void InputTrace::LoadText(const std::string& path, const std::string& data) {
+	std::istringstream file(data);
+
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream linestream(line);
+
+		long ticks;
+		std::string keys;
+		if (!(linestream >> ticks >> keys) || ticks < 0)
+			throw std::runtime_error("cannot parse input trace " + path + ": bad line `" + line + "'");
+
+		int flags = 0;
+		for (auto key : keys) {
+			switch (key) {
+			case 'L': flags |= (int)GameWorld::ControlFlags::LEFT; break;
+			case 'R': flags |= (int)GameWorld::ControlFlags::RIGHT; break;
+			case 'U': flags |= (int)GameWorld::ControlFlags::UP; break;
+			case '-': break;
+			default:
+				throw std::runtime_error("cannot parse input trace " + path + ": unknown key `" + key + "'");
+			}
+		}
+
+		Append(flags, ticks);
+	}
+}
+
+void InputTrace::Save(const std::string& path) const {
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0)
+		SaveText(path);
+	else
+		SaveBinary(path);
+}
+
+void InputTrace::SaveBinary(const std::string& path) const {
+	std::string data(kMagic, sizeof(kMagic));
+
+	auto write_le = [&data](uint64_t value, int bytes) {
+		for (int i = 0; i < bytes; i++)
+			data.push_back((char)(value >> (i * 8)));
+	};
+
+	write_le(kVersion, 4);
+	write_le(hash_interval_, 4);
+	write_le(runs_.size(), 4);
+	write_le(hashes_.size(), 4);
+
+	for (const auto& run : runs_) {
+		data.push_back((char)run.flags);
+
+		uint64_t ticks = run.ticks;
+		do {
+			data.push_back((char)((ticks & 0x7f) | (ticks > 0x7f ? 0x80 : 0)));
+			ticks >>= 7;
+		} while (ticks);
+	}
+
+	for (auto hash : hashes_)
+		write_le(hash, 8);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("cannot create input trace " + path);
+
+	file.write(data.data(), data.size());
+
+	if (!file)
+		throw std::runtime_error("cannot write input trace " + path);
+}
+
+void InputTrace::SaveText(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("cannot create input trace " + path);
+
+	for (const auto& run : runs_) {
+		file << run.ticks << " ";
+		if (run.flags == 0)
+			file << "-";
+		if (run.flags & (int)GameWorld::ControlFlags::LEFT)
+			file << "L";
+		if (run.flags & (int)GameWorld::ControlFlags::RIGHT)
+			file << "R";
+		if (run.flags & (int)GameWorld::ControlFlags::UP)
+			file << "U";
+		file << "\n";
+	}
+
+	if (!file)
+		throw std::runtime_error("cannot write input trace " + path);
+}
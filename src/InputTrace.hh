@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUTTRACE_HH
+#define INPUTTRACE_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-tick control flags of a single playthrough, stored run-length
+// encoded, optionally along with hashes of resulting player state
+// (see GameWorld::GetStateHash) taken every hash interval ticks,
+// which allow to verify that replaying the trace gives the same
+// results
+//
+// Binary form is a header followed by runs, each as a byte of
+// flags and LEB128 encoded number of ticks, and then by hashes;
+// all integers are little-endian.
+//
+// Text form has one run per line, in the form of `<ticks> <keys>',
+// where keys is any combination of L, R and U letters (for left,
+// right and up controls), or `-' for no keys. Empty lines and lines
+// starting with `#' are ignored. Text form carries no hashes.
+class InputTrace {
+public:
+	struct Run {
+		unsigned int ticks;
+		int flags;
+	};
+
+	static constexpr unsigned int kDefaultHashInterval = 100;
+
+	// Sequential per-tick access to control flags
+	class Reader {
+	private:
+		const InputTrace& trace_;
+		size_t run_ = 0;
+		unsigned int tick_ = 0;
+
+	public:
+		Reader(const InputTrace& trace);
+
+		bool AtEnd() const;
+
+		// Flags for the next tick
+		int Next();
+	};
+
+private:
+	std::vector<Run> runs_;
+
+	unsigned int hash_interval_ = kDefaultHashInterval;
+	std::vector<uint64_t> hashes_;
+
+private:
+	void LoadBinary(const std::string& path, const std::string& data);
+	void LoadText(const std::string& path, const std::string& data);
+	void SaveBinary(const std::string& path) const;
+	void SaveText(const std::string& path) const;
+
+public:
+	InputTrace();
+	InputTrace(const std::string& path);
+
+	void Append(int flags, unsigned int ticks = 1);
+
+	const std::vector<Run>& GetRuns() const;
+	unsigned long GetLength() const;
+
+	// Drops ticks and hashes past given length
+	void Truncate(unsigned long length);
+
+	// Changing interval drops stored hashes
+	void SetHashInterval(unsigned int interval);
+	unsigned int GetHashInterval() const;
+
+	// Hash of state after given number of ticks is due
+	bool IsHashTick(unsigned long tick) const;
+
+	void AppendHash(uint64_t hash);
+	const std::vector<uint64_t>& GetHashes() const;
+
+	// False if hash of state after given number of ticks is known
+	// and differs from the given one
+	bool CheckHash(unsigned long tick, uint64_t hash) const;
+
+	// Loads either format, based on file contents
+	void Load(const std::string& path);
+
+	// Saves text form if path ends with .txt, binary otherwise
+	void Save(const std::string& path) const;
+};
+
+#endif // INPUTTRACE_HH
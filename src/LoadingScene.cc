@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LoadingScene.hh"
+
+#include <algorithm>
+
+#include "GameScene.hh"
+
+LoadingScene::LoadingScene(Application& app, const std::string& map_path, LowresPainter::Backend backend, const std::string& record_path, const std::string& replay_path)
+	: Scene(app),
+	  loader_(GetAssetCache(), map_path, DATADIR "/images/tiles.png"),
+	  backend_(backend),
+	  record_path_(record_path),
+	  replay_path_(replay_path) {
+}
+
+void LoadingScene::Update(float /*delta_time*/) {
+	if (loader_.IsDone())
+		SetNextScene<GameScene>(loader_.Take(), backend_, record_path_, replay_path_);
+}
+
+void LoadingScene::Render(float /*alpha*/) {
+	SDL2pp::Renderer& renderer = GetRenderer();
+
+	renderer.SetDrawColor(0, 0, 0);
+	renderer.Clear();
+
+	// progress bar in the middle of the window
+	const int width = renderer.GetOutputWidth() / 2;
+	const int height = std::max(renderer.GetOutputHeight() / 32, 4);
+	const SDL2pp::Rect bar((renderer.GetOutputWidth() - width) / 2, (renderer.GetOutputHeight() - height) / 2, width, height);
+
+	renderer.SetDrawColor(255, 255, 255);
+	renderer.FillRect(SDL2pp::Rect(bar.x, bar.y, (int)(bar.w * loader_.GetProgress()), bar.h));
+	renderer.DrawRect(bar);
+}
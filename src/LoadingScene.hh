@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOADINGSCENE_HH
+#define LOADINGSCENE_HH
+
+#include <string>
+
+#include "AssetLoader.hh"
+#include "LowresPainter.hh"
+#include "Scene.hh"
+
+// Shows progress bar while assets are loaded in background, then
+// switches to GameScene
+class LoadingScene : public Scene {
+private:
+	AssetLoader loader_;
+
+	// passed on to GameScene
+	const LowresPainter::Backend backend_;
+	const std::string record_path_;
+	const std::string replay_path_;
+
+public:
+	// Map may be either .tmx or precompiled, see GameMap
+	LoadingScene(Application& app, const std::string& map_path, LowresPainter::Backend backend = LowresPainter::Backend::ACCELERATED, const std::string& record_path = "", const std::string& replay_path = "");
+
+	virtual void Update(float delta_time) override;
+	virtual void Render(float alpha) override;
+};
+
+#endif // LOADINGSCENE_HH
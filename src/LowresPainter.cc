@@ -19,38 +19,232 @@
 
 #include "LowresPainter.hh"
 
-LowresPainter::LowresPainter(SDL2pp::Renderer& renderer, SDL2pp::Texture& tiles, int width, int height)
+#include <algorithm>
+
+#include <SDL2pp/Exception.hh>
+
+#include "Constants.hh"
+#include "GameMap.hh"
+#include "Profiler.hh"
+
+// flip variants of atlas are arranged in 2 columns by 4 rows
+static const int kVariantColumns = 2;
+static const int kVariantRows = GameMap::NUM_FLIP_VARIANTS / kVariantColumns;
+
+SoftwareRasterizer LowresPainter::BuildAtlas(SDL2pp::Surface tiles) {
+	const int width = tiles.GetWidth();
+	const int height = tiles.GetHeight();
+
+	SoftwareRasterizer variants(width * kVariantColumns, height * kVariantRows);
+
+	{
+		SDL2pp::Surface argb_tiles = tiles.Convert(SDL_PIXELFORMAT_ARGB8888);
+		SDL2pp::Surface::LockHandle lock = argb_tiles.Lock();
+		variants.SetAtlas(lock.GetPixels(), width, height, lock.GetPitch());
+	}
+
+	// unflipped variant is whole atlas including sprites, others
+	// only make sense for tiles
+	variants.Clear(0);
+	variants.Blit(SDL2pp::Rect(0, 0, width, height), SDL2pp::Point(0, 0));
+	for (unsigned int flips = 1; flips < GameMap::NUM_FLIP_VARIANTS; flips++)
+		for (int y = 0; y + kTileSize <= height; y += kTileSize)
+			for (int x = 0; x + kTileSize <= width; x += kTileSize)
+				variants.Blit(SDL2pp::Rect(x, y, kTileSize, kTileSize), SDL2pp::Point(flips % kVariantColumns * width + x, flips / kVariantColumns * height + y), flips);
+
+	return variants;
+}
+
+SDL2pp::Texture LowresPainter::CreateAtlasTexture(SDL2pp::Renderer& renderer, const SoftwareRasterizer& atlas) {
+	SDL2pp::Texture texture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, atlas.GetWidth(), atlas.GetHeight());
+	texture.Update(SDL2pp::NullOpt, atlas.GetPixels(), atlas.GetPitch());
+	texture.SetBlendMode(SDL_BLENDMODE_BLEND);
+	return texture;
+}
+
+LowresPainter::LowresPainter(SDL2pp::Renderer& renderer, const SoftwareRasterizer& atlas, std::shared_ptr<SDL2pp::Texture> atlas_texture, int width, int height, Backend backend)
 	: renderer_(renderer),
-	  tiles_(tiles),
+	  backend_(backend),
+	  atlas_width_(atlas.GetWidth() / kVariantColumns),
+	  atlas_height_(atlas.GetHeight() / kVariantRows),
+	  tiles_(atlas_texture),
+	  framebuffer_(renderer, SDL_PIXELFORMAT_ARGB8888, backend == Backend::SOFTWARE ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET, width, height),
 	  screen_width_(width),
 	  screen_height_(height) {
+	if (backend_ == Backend::SOFTWARE) {
+		rasterizer_.reset(new SoftwareRasterizer(width, height));
+		rasterizer_->SetAtlas(atlas.GetPixels(), atlas.GetWidth(), atlas.GetHeight(), atlas.GetPitch());
+	}
+
 	UpdateSize();
 }
 
+void LowresPainter::SetAtlas(const SoftwareRasterizer& atlas, std::shared_ptr<SDL2pp::Texture> atlas_texture) {
+	// quads batched so far use old texture coordinates
+	Flush();
+
+	atlas_width_ = atlas.GetWidth() / kVariantColumns;
+	atlas_height_ = atlas.GetHeight() / kVariantRows;
+	tiles_ = atlas_texture;
+
+	if (rasterizer_)
+		rasterizer_->SetAtlas(atlas.GetPixels(), atlas.GetWidth(), atlas.GetHeight(), atlas.GetPitch());
+}
+
+SDL2pp::Point LowresPainter::GetVariantOrigin(unsigned int flips) const {
+	return SDL2pp::Point(flips % kVariantColumns * atlas_width_, flips / kVariantColumns * atlas_height_);
+}
+
+bool LowresPainter::IsAccelerated() const {
+	return backend_ == Backend::ACCELERATED;
+}
+
 void LowresPainter::UpdateSize() {
 	int target_width = renderer_.GetOutputWidth();
 	int target_height = renderer_.GetOutputHeight();
 
-	scale_factor_ = std::min(target_width/screen_width_, target_height/screen_height_);
-	if (scale_factor_ < 1)
-		scale_factor_ = 1;
+	int scale_factor = std::min(target_width/screen_width_, target_height/screen_height_);
+	if (scale_factor < 1)
+		scale_factor = 1;
 
-	offset_ = SDL2pp::Point(
-			(target_width - screen_width_ * scale_factor_) / 2,
-			(target_height - screen_height_ * scale_factor_) / 2
+	output_rect_ = SDL2pp::Rect(
+			(target_width - screen_width_ * scale_factor) / 2,
+			(target_height - screen_height_ * scale_factor) / 2,
+			screen_width_ * scale_factor,
+			screen_height_ * scale_factor
 		);
+}
+
+void LowresPainter::Copy(const SDL2pp::Rect& tile_src, const SDL2pp::Point& dst, unsigned int flips) {
+	SDL2pp::Rect src = tile_src;
+
+	// flipped tiles come from pre-flipped atlas variants; other
+	// flipped rects (sprites) are transformed when drawn
+	if (flips != 0 && src.w == kTileSize && src.h == kTileSize && src.x % kTileSize == 0 && src.y % kTileSize == 0) {
+		src = src + GetVariantOrigin(flips);
+		flips = 0;
+	}
 
-	renderer_.SetClipRect(SDL2pp::Rect(offset_.x, offset_.y, screen_width_ * scale_factor_, screen_height_ * scale_factor_));
+	if (rasterizer_) {
+		rasterizer_->Blit(src, dst, flips);
+		return;
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	// flipped width and height
+	const int width = (flips & GameMap::DFLIP) ? src.h : src.w;
+	const int height = (flips & GameMap::DFLIP) ? src.w : src.h;
+
+	const float texture_width = tiles_->GetWidth();
+	const float texture_height = tiles_->GetHeight();
+
+	const int first = vertices_.size();
+
+	// flips are expressed by choosing which source corner goes
+	// to each destination corner
+	static const int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	for (const auto& corner : corners) {
+		int x = corner[0], y = corner[1];
+		int u = (flips & GameMap::HFLIP) ? 1 - x : x;
+		int v = (flips & GameMap::VFLIP) ? 1 - y : y;
+		if (flips & GameMap::DFLIP)
+			std::swap(u, v);
+
+		SDL_Vertex vertex;
+		vertex.position.x = dst.x + x * width;
+		vertex.position.y = dst.y + y * height;
+		vertex.color = SDL_Color{ 255, 255, 255, 255 };
+		vertex.tex_coord.x = (src.x + u * src.w) / texture_width;
+		vertex.tex_coord.y = (src.y + v * src.h) / texture_height;
+		vertices_.push_back(vertex);
+	}
+
+	for (int index : { 0, 1, 2, 0, 2, 3 })
+		indices_.push_back(first + index);
+#else
+	Profiler::Count(Profiler::DRAW_CALLS);
+
+	if (flips == 0) {
+		renderer_.Copy(*tiles_, src, SDL2pp::Rect(dst.x, dst.y, src.w, src.h));
+		return;
+	}
+
+	// express tiled's flipping flags as SDL flip and rotation
+	int flipflag = 0;
+	double angle = 0.0;
+	if (flips & GameMap::DFLIP) {
+		flipflag = (flips & GameMap::HFLIP ? 0 : SDL_FLIP_VERTICAL) | (flips & GameMap::VFLIP ? SDL_FLIP_HORIZONTAL : 0);
+		angle = 90.0;
+	} else {
+		flipflag = (flips & GameMap::HFLIP ? SDL_FLIP_HORIZONTAL : 0) | (flips & GameMap::VFLIP ? SDL_FLIP_VERTICAL : 0);
+		angle = 0.0;
+	}
+
+	renderer_.Copy(*tiles_, src, SDL2pp::Rect(dst.x, dst.y, src.w, src.h), angle, SDL2pp::NullOpt, flipflag);
+#endif
+}
+
+void LowresPainter::Copy(SDL2pp::Texture& texture, const SDL2pp::Point& dst) {
+	// keep drawing order
+	Flush();
+
+	Profiler::Count(Profiler::DRAW_CALLS);
+
+	renderer_.Copy(texture, SDL2pp::NullOpt, SDL2pp::Rect(dst.x, dst.y, texture.GetWidth(), texture.GetHeight()));
+}
+
+void LowresPainter::FillRect(const SDL2pp::Rect& rect, Uint8 r, Uint8 g, Uint8 b) {
+	if (rasterizer_) {
+		rasterizer_->Fill(rect, 0xff000000 | (r << 16) | (g << 8) | b);
+		return;
+	}
+
+	// keep drawing order
+	Flush();
+
+	Profiler::Count(Profiler::DRAW_CALLS);
+	renderer_.SetDrawColor(r, g, b);
+	renderer_.FillRect(rect);
 }
 
-void LowresPainter::Copy(const SDL2pp::Rect& src, const SDL2pp::Point& dst) {
-	renderer_.Copy(tiles_, src, SDL2pp::Rect(offset_.x + dst.x * scale_factor_, offset_.y + dst.y * scale_factor_, src.w * scale_factor_, src.h * scale_factor_));
+void LowresPainter::Flush() {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	if (indices_.empty())
+		return;
+
+	Profiler::Count(Profiler::DRAW_CALLS);
+
+	if (SDL_RenderGeometry(renderer_.Get(), tiles_->Get(), vertices_.data(), vertices_.size(), indices_.data(), indices_.size()) != 0)
+		throw SDL2pp::Exception("SDL_RenderGeometry");
+
+	vertices_.clear();
+	indices_.clear();
+#endif
 }
 
-void LowresPainter::Copy(const SDL2pp::Rect& src, const SDL2pp::Point& dst, double angle, const SDL2pp::Optional<SDL2pp::Point>& center, int flip) {
-	renderer_.Copy(tiles_, src, SDL2pp::Rect(offset_.x + dst.x * scale_factor_, offset_.y + dst.y * scale_factor_, src.w * scale_factor_, src.h * scale_factor_), angle, center, flip);
+void LowresPainter::Clear(Uint8 r, Uint8 g, Uint8 b) {
+	if (rasterizer_) {
+		rasterizer_->Clear(0xff000000 | (r << 16) | (g << 8) | b);
+		return;
+	}
+
+	renderer_.SetTarget(framebuffer_);
+	renderer_.SetDrawColor(r, g, b);
+	renderer_.Clear();
 }
 
-void LowresPainter::Clear() {
-	renderer_.FillRect(SDL2pp::Rect(offset_.x, offset_.y, screen_width_ * scale_factor_, screen_height_ * scale_factor_));
+void LowresPainter::Present() {
+	Flush();
+
+	if (rasterizer_)
+		framebuffer_.Update(SDL2pp::NullOpt, rasterizer_->GetPixels(), rasterizer_->GetPitch());
+	else
+		renderer_.SetTarget();
+
+	// clear whole window to make actual rendering area visible
+	renderer_.SetDrawColor(16, 16, 16);
+	renderer_.Clear();
+
+	Profiler::Count(Profiler::DRAW_CALLS);
+	renderer_.Copy(framebuffer_, SDL2pp::NullOpt, output_rect_);
 }
@@ -20,28 +20,94 @@
 #ifndef LOWRESPAINTER_HH
 #define LOWRESPAINTER_HH
 
+#include <memory>
+#include <vector>
+
 #include <SDL2pp/Renderer.hh>
+#include <SDL2pp/Surface.hh>
 #include <SDL2pp/Texture.hh>
 #include <SDL2pp/Rect.hh>
 
+#include "SoftwareRasterizer.hh"
+
+// Renders into native resolution framebuffer, which is then
+// presented with a single integer-scaled copy. Framebuffer is
+// either a target texture drawn by SDL renderer, or a CPU side
+// buffer uploaded once per frame
 class LowresPainter {
+public:
+	enum class Backend {
+		ACCELERATED,
+		SOFTWARE,
+	};
+
 private:
 	SDL2pp::Renderer& renderer_;
-	SDL2pp::Texture& tiles_;
+	const Backend backend_;
+
+	// tiles atlas followed by its copies with each combination of
+	// tiled's flipping flags applied to every tile in place, so
+	// flipped tiles are drawn without any transformation
+	int atlas_width_;
+	int atlas_height_;
+	std::shared_ptr<SDL2pp::Texture> tiles_;
+	SDL2pp::Texture framebuffer_;
+
+	// software backend only
+	std::unique_ptr<SoftwareRasterizer> rasterizer_;
+
+	// accelerated backend: atlas quads collected for a single
+	// geometry submission
+	std::vector<SDL_Vertex> vertices_;
+	std::vector<int> indices_;
 
 	const int screen_width_;
 	const int screen_height_;
 
-	SDL2pp::Point offset_;
-	int scale_factor_;
+	// placement of scaled framebuffer in the window
+	SDL2pp::Rect output_rect_;
+
+private:
+	SDL2pp::Point GetVariantOrigin(unsigned int flips) const;
 
 public:
-	LowresPainter(SDL2pp::Renderer& renderer, SDL2pp::Texture& tiles, int width, int height);
+	// Tiles atlas along with its flipped variants; doesn't need
+	// renderer, so may be built on any thread
+	static SoftwareRasterizer BuildAtlas(SDL2pp::Surface tiles);
+
+	// Texture with atlas built by BuildAtlas()
+	static SDL2pp::Texture CreateAtlasTexture(SDL2pp::Renderer& renderer, const SoftwareRasterizer& atlas);
+
+	// Uses atlas built by BuildAtlas() along with its texture,
+	// which may be shared between painters
+	LowresPainter(SDL2pp::Renderer& renderer, const SoftwareRasterizer& atlas, std::shared_ptr<SDL2pp::Texture> atlas_texture, int width, int height, Backend backend = Backend::ACCELERATED);
+
+	// Switches to another atlas, e.g. one reloaded after editing
+	void SetAtlas(const SoftwareRasterizer& atlas, std::shared_ptr<SDL2pp::Texture> atlas_texture);
+
+	bool IsAccelerated() const;
 
 	void UpdateSize();
-	void Copy(const SDL2pp::Rect& src, const SDL2pp::Point& dst);
-	void Copy(const SDL2pp::Rect& src, const SDL2pp::Point& dst, double angle, const SDL2pp::Optional<SDL2pp::Point>& center = SDL2pp::NullOpt, int flip = 0);
-	void Clear();
+
+	// Copies part of tiles atlas, with a combination of tiled's
+	// flipping flags (GameMap::TileFlips) applied
+	void Copy(const SDL2pp::Rect& src, const SDL2pp::Point& dst, unsigned int flips = 0);
+
+	// Copies whole texture; accelerated backend only
+	void Copy(SDL2pp::Texture& texture, const SDL2pp::Point& dst);
+
+	void FillRect(const SDL2pp::Rect& rect, Uint8 r, Uint8 g, Uint8 b);
+
+	// Submits atlas copies batched so far; needed before render
+	// target is changed behind painter's back
+	void Flush();
+
+	// Starts a frame: clears framebuffer with given color and
+	// directs rendering into it
+	void Clear(Uint8 r, Uint8 g, Uint8 b);
+
+	// Finishes a frame: copies framebuffer to the window
+	void Present();
 };
 
 #endif // LOWRESPAINTER_HH
@@ -17,14 +17,51 @@
  * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-#include "GameScene.hh"
+#include "LoadingScene.hh"
+
+static void Usage(const char* progname) {
+	std::cerr << "Usage: " << progname << " [-m map.tmx|map.pmap] [-s] [-p profile.csv|profile.json] [-r trace] [-R trace]" << std::endl;
+	std::cerr << "  -m  map to play, either .tmx or precompiled with planetonomy_mapc;" << std::endl;
+	std::cerr << "      bundled map precompiled at build time is played by default" << std::endl;
+	std::cerr << "  -s  render on CPU instead of using accelerated renderer" << std::endl;
+	std::cerr << "  -p  save frame timings and counters on exit" << std::endl;
+	std::cerr << "  -r  record controls into input trace" << std::endl;
+	std::cerr << "  -R  replay controls from input trace, checking for divergence" << std::endl;
+}
+
+int main(int argc, char** argv) try {
+	std::string map_path = BUNDLED_PMAP;
+	LowresPainter::Backend backend = LowresPainter::Backend::ACCELERATED;
+	std::string profile_path;
+	std::string record_path;
+	std::string replay_path;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			map_path = argv[++i];
+		} else if (std::strcmp(argv[i], "-s") == 0) {
+			backend = LowresPainter::Backend::SOFTWARE;
+		} else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			profile_path = argv[++i];
+		} else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			record_path = argv[++i];
+		} else if (std::strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+			replay_path = argv[++i];
+		} else {
+			Usage(argv[0]);
+			return 1;
+		}
+	}
 
-int main(int /*argc*/, char** /*argv*/) try {
 	Application app("planetonomy");
-	app.Run<GameScene>();
+	if (!profile_path.empty())
+		app.SetProfilePath(profile_path);
+	app.Run<LoadingScene>(map_path, backend, record_path, replay_path);
 	return 0;
 } catch (std::exception& e) {
 	std::cerr << "Error: " << e.what() << std::endl;
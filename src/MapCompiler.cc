@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MapCompiler.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <SDL2pp/Point.hh>
+
+#include <pugixml.hpp>
+
+#include <zlib.h>
+
+MapCompiler::MapCompiler(const std::string& tmxpath) {
+	// prase .tmx xml
+	pugi::xml_document tmxdoc;
+
+	if (!tmxdoc.load_file(tmxpath.c_str()))
+		throw std::runtime_error("cannot load map file");
+
+	Compile(tmxdoc.child("map"));
+}
+
+MapCompiler::MapCompiler(const char* tmxdata, size_t size) {
+	pugi::xml_document tmxdoc;
+
+	if (!tmxdoc.load_buffer(tmxdata, size))
+		throw std::runtime_error("cannot load map data");
+
+	Compile(tmxdoc.child("map"));
+}
+
+void MapCompiler::Compile(const pugi::xml_node& map) {
+	ParseTileset(map);
+	ParseMap(map);
+	ParseObjects(map);
+
+	BakeCollisionMaps();
+	BakeCollisionMasks();
+}
+
+void MapCompiler::ParseTileset(const pugi::xml_node& map) {
+	auto tileset = map.child("tileset");
+	int firstgid = tileset.attribute("firstgid").as_int();
+
+	int tilewidth = tileset.attribute("tilewidth").as_int();
+	int tileheight = tileset.attribute("tileheight").as_int();
+
+	int imagewidth = tileset.child("image").attribute("width").as_int();
+	int imageheight = tileset.child("image").attribute("height").as_int();
+
+	int tilesinrow = imagewidth / tilewidth;
+	int tilesincol = imageheight / tileheight;
+
+	if (tilewidth <= 0 || tileheight <= 0 || imagewidth <= 0 || imageheight <= 0)
+			throw std::runtime_error("cannot process map file: unexpected tileset dimensions");
+
+	// slot 0 is reserved for empty tile
+	tile_infos_.resize(firstgid + tilesinrow * tilesincol);
+	collision_maps_.resize(tile_infos_.size());
+
+	// parse plain tiles
+	for (auto tile = tileset.child("tile"); tile; tile = tile.next_sibling("tile")) {
+		int global_id = tile.attribute("id").as_int() + firstgid;
+		if (global_id < 1)
+			throw std::runtime_error("cannot process map file: unexpected tile id");
+
+		GameMap::TileInfo ti;
+		GameMap::CollisionMap collision_map;
+
+		// properties
+		for (auto property = tile.child("properties").child("property"); property; property = property.next_sibling("property")) {
+			if (std::strcmp(property.attribute("name").as_string(), "deadly") == 0)
+				ti.deadly_flag = true;
+		}
+
+		// collision
+		for (auto rect = tile.child("objectgroup").child("object"); rect; rect = rect.next_sibling("object")) {
+			collision_map.emplace_back(
+					rect.attribute("x").as_int(),
+					rect.attribute("y").as_int(),
+					rect.attribute("width").as_int(),
+					rect.attribute("height").as_int()
+				);
+		}
+
+		if ((unsigned int)global_id >= tile_infos_.size()) {
+			tile_infos_.resize(global_id + 1);
+			collision_maps_.resize(global_id + 1);
+		}
+
+		tile_infos_[global_id] = ti;
+		collision_maps_[global_id] = collision_map;
+	}
+
+	// fill rects for all tiles possibly present in the tileset
+	for (int id = 0; id < tilesinrow * tilesincol; id++) {
+		int global_id = id + firstgid;
+		tile_infos_[global_id].source_rect = SDL2pp::Rect(
+				(id % tilesinrow) * tilewidth,
+				(id / tilesinrow) * tileheight,
+				tilewidth,
+				tileheight
+			);
+	}
+
+	// parse metatiles tiles
+	for (auto tile = tileset.child("tile"); tile; tile = tile.next_sibling("tile")) {
+		int global_id = tile.attribute("id").as_int() + firstgid;
+		if (global_id < 1)
+			throw std::runtime_error("cannot process map file: unexpected tile id");
+
+		int width = 1;
+		int height = 1;
+		std::string name;
+
+		for (auto property = tile.child("properties").child("property"); property; property = property.next_sibling("property")) {
+			if (std::strcmp(property.attribute("name").as_string(), "width") == 0)
+				width = property.attribute("value").as_int();
+			else if (std::strcmp(property.attribute("name").as_string(), "height") == 0)
+				height = property.attribute("value").as_int();
+			else if (std::strcmp(property.attribute("name").as_string(), "name") == 0)
+				name = property.attribute("value").as_string();
+		}
+
+		if (name == "") // not a metatile
+			continue;
+
+		if (width < 1 || height < 1)
+			throw std::runtime_error("cannot process map file: invalid metatile size");
+
+		if (name.size() >= MapFormat::kMaxMetaTileName)
+			throw std::runtime_error("cannot process map file: metatile name too long");
+
+		MetaTileInfo mti;
+
+		mti.source_rect = tile_infos_[global_id].source_rect;
+		mti.source_rect.w = width * tilewidth;
+		mti.source_rect.h = height * tileheight;
+
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < height; x++)
+				for (const auto& rect : collision_maps_[global_id])
+					mti.collision_map.push_back(rect + SDL2pp::Point(x * tilewidth, y * tileheight));
+
+		metatile_infos_.emplace_back(name, mti);
+	}
+
+	// empty tile
+	tile_infos_[0] = GameMap::TileInfo();
+	collision_maps_[0].clear();
+}
+
+void MapCompiler::ParseMap(const pugi::xml_node& map) {
+	width_ = map.attribute("width").as_int();
+	height_ = map.attribute("height").as_int();
+
+	auto data = map.child("layer").child("data");
+	const char* contents = data.child_value();
+
+	if (width_ == 0 || height_ == 0 || *contents == '\0')
+		throw std::runtime_error("cannot parse map file: cannot get map dimensions or contents");
+
+	const char* encoding = data.attribute("encoding").as_string();
+	const char* compression = data.attribute("compression").as_string();
+
+	if (std::strcmp(encoding, "csv") == 0 && *compression == '\0')
+		ParseCsvData(contents);
+	else if (std::strcmp(encoding, "base64") == 0)
+		ParseBase64Data(contents, compression);
+	else
+		throw std::runtime_error("cannot parse map file: unsupported layer encoding or compression");
+}
+
+void MapCompiler::ParseCsvData(const char* contents) {
+	map_data_.clear();
+	map_data_.reserve(width_ * height_);
+
+	// parse tile array; note that terminating null is processed
+	// as well, to flush the last number
+	uint32_t curint = 0;
+	unsigned int curlen = 0;
+	const char* ch = contents;
+	do {
+		if (*ch >= '0' && *ch <= '9') {
+			curint = curint * 10 + *ch - '0';
+			curlen++;
+		} else {
+			if (curlen)
+				map_data_.push_back(curint);
+			curint = 0;
+			curlen = 0;
+		}
+	} while (*ch++ != '\0');
+
+	if (map_data_.size() != width_ * height_)
+		throw std::runtime_error("cannot parse map file: unexpected number of tiles in the map");
+}
+
+namespace {
+
+// Streaming base64 decoder, skips whitespace
+class Base64Reader {
+private:
+	enum {
+		SKIP = 0x40,
+		INVALID = 0x80,
+	};
+
+	struct Table {
+		unsigned char values[256];
+
+		Table() {
+			std::memset(values, INVALID, sizeof(values));
+
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for (int value = 0; value < 64; value++)
+				values[(unsigned char)alphabet[value]] = value;
+
+			values[(unsigned char)' '] = values[(unsigned char)'\t'] = values[(unsigned char)'\r'] = values[(unsigned char)'\n'] = SKIP;
+		}
+	};
+
+	const char* pos_;
+	uint32_t accum_ = 0;
+	int accum_bits_ = 0;
+
+public:
+	Base64Reader(const char* text) : pos_(text) {
+	}
+
+	// Decodes up to size bytes into buffer; returns number of
+	// bytes decoded, which is only less than size at the end
+	// of input
+	size_t Read(unsigned char* buffer, size_t size) {
+		static const Table table; // thread safe initialization
+
+		size_t done = 0;
+		while (done < size && *pos_ != '\0' && *pos_ != '=') {
+			unsigned char value = table.values[(unsigned char)*pos_++];
+
+			if (value == SKIP)
+				continue;
+			if (value == INVALID)
+				throw std::runtime_error("cannot parse map file: bad base64 data");
+
+			accum_ = (accum_ << 6) | value;
+			accum_bits_ += 6;
+
+			if (accum_bits_ >= 8) {
+				accum_bits_ -= 8;
+				buffer[done++] = (accum_ >> accum_bits_) & 0xff;
+			}
+		}
+		return done;
+	}
+};
+
+}
+
+void MapCompiler::ParseBase64Data(const char* contents, const char* compression) {
+	// tiles are decoded right into the final array
+	map_data_.assign(width_ * height_, 0);
+	unsigned char* output = reinterpret_cast<unsigned char*>(map_data_.data());
+	const size_t output_size = map_data_.size() * sizeof(uint32_t);
+
+	Base64Reader reader(contents);
+	unsigned char extra;
+
+	if (*compression == '\0') {
+		if (reader.Read(output, output_size) != output_size || reader.Read(&extra, 1) != 0)
+			throw std::runtime_error("cannot parse map file: unexpected number of tiles in the map");
+	} else {
+		int window_bits;
+		if (std::strcmp(compression, "zlib") == 0)
+			window_bits = 15;
+		else if (std::strcmp(compression, "gzip") == 0)
+			window_bits = 15 + 16;
+		else
+			throw std::runtime_error("cannot parse map file: unsupported layer compression");
+
+		z_stream stream;
+		std::memset(&stream, 0, sizeof(stream));
+
+		if (inflateInit2(&stream, window_bits) != Z_OK)
+			throw std::runtime_error("cannot parse map file: cannot initialize decompression");
+
+		stream.next_out = output;
+		stream.avail_out = output_size;
+
+		// feed decoded base64 to zlib in small chunks
+		unsigned char input[16384];
+		int ret = Z_OK;
+		while (ret != Z_STREAM_END) {
+			if (stream.avail_in == 0) {
+				stream.next_in = input;
+				stream.avail_in = reader.Read(input, sizeof(input));
+			}
+
+			ret = inflate(&stream, Z_NO_FLUSH);
+
+			if (ret == Z_BUF_ERROR && stream.avail_in == 0)
+				break; // input exhausted
+			if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+				break; // corrupt data
+			if (stream.avail_out == 0 && stream.avail_in != 0 && ret != Z_STREAM_END)
+				break; // more data than expected; otherwise end of
+				       // stream may still be in the next input chunk
+		}
+
+		inflateEnd(&stream);
+
+		if (ret != Z_STREAM_END || stream.avail_out != 0)
+			throw std::runtime_error("cannot parse map file: bad compressed layer data");
+	}
+
+	// tiled stores tiles as little-endian 32 bit integers
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	for (auto& tile : map_data_)
+		tile = SDL_SwapLE32(tile);
+#endif
+}
+
+void MapCompiler::ParseObjects(const pugi::xml_node& map) {
+	pugi::xml_node objects_group;
+	for (auto objectgroup = map.child("objectgroup"); objectgroup; objectgroup = objectgroup.next_sibling("objectgroup"))
+		if (std::strcmp(objectgroup.attribute("name").as_string(), "Objects") == 0)
+			objects_group = objectgroup;
+
+	if (!objects_group)
+		throw std::runtime_error("cannot parse map file: objects layer not found");
+
+	for (auto object = objects_group.child("object"); object; object = object.next_sibling("object")) {
+		GameMap::ObjectTypes type;
+
+		const auto objtypename = object.attribute("type").as_string();
+		if (std::strcmp(objtypename, "lander") == 0) {
+			type = GameMap::LANDER;
+		} else if (std::strcmp(objtypename, "player_start") == 0) {
+			type = GameMap::PLAYER_START;
+		} else if (std::strcmp(objtypename, "mouth_monster") == 0) {
+			type = GameMap::MOUTH_MONSTER;
+		} else if (std::strcmp(objtypename, "checkpoint") == 0) {
+			type = GameMap::CHECKPOINT;
+		} else {
+			std::cerr << "WARNING: Unknown object type: " << objtypename << std::endl;
+			continue;
+		}
+
+		objects_.emplace_back(GameMap::Object{
+				type,
+				{
+					object.attribute("x").as_int(),
+					object.attribute("y").as_int(),
+					object.attribute("width").as_int(),
+					object.attribute("height").as_int()
+				}
+			});
+	}
+
+	// for lookup by type
+	std::stable_sort(objects_.begin(), objects_.end(), [](const GameMap::Object& a, const GameMap::Object& b) { return a.type < b.type; });
+}
+
+void MapCompiler::BakeCollisionMaps() {
+	collision_rects_.clear();
+
+	// store all flip variants of each tile's collision map
+	// in a contiguous array, so lookups don't need to
+	// transform or allocate anything
+	for (size_t id = 0; id < tile_infos_.size(); id++) {
+		tile_infos_[id].collision_offset = collision_rects_.size();
+		tile_infos_[id].collision_count = collision_maps_[id].size();
+
+		for (unsigned int flips = 0; flips < GameMap::NUM_FLIP_VARIANTS; flips++) {
+			for (auto rect : collision_maps_[id]) {
+				if (flips & GameMap::DFLIP) {
+					std::swap(rect.x, rect.y);
+					std::swap(rect.w, rect.h);
+				}
+				if (flips & GameMap::HFLIP)
+					rect.x = kTileSize - rect.x - rect.w;
+				if (flips & GameMap::VFLIP)
+					rect.y = kTileSize - rect.y - rect.h;
+
+				collision_rects_.emplace_back(rect);
+			}
+		}
+	}
+
+	// metatile collision maps follow
+	metatiles_.clear();
+	for (const auto& name_info : metatile_infos_) {
+		MapFormat::MetaTile metatile = MapFormat::MetaTile(); // zero-filled
+
+		std::strncpy(metatile.name, name_info.first.c_str(), sizeof(metatile.name) - 1);
+		metatile.source_rect = name_info.second.source_rect;
+		metatile.collision_offset = collision_rects_.size();
+		metatile.collision_count = name_info.second.collision_map.size();
+
+		collision_rects_.insert(collision_rects_.end(), name_info.second.collision_map.begin(), name_info.second.collision_map.end());
+
+		metatiles_.push_back(metatile);
+	}
+}
+
+void MapCompiler::BakeCollisionMasks() {
+	tile_masks_.clear();
+
+	// rasterize pretransformed collision maps into bit masks
+	for (auto& tileinfo : tile_infos_) {
+		tileinfo.mask_offset = tile_masks_.size();
+
+		const SDL2pp::Rect* rect = collision_rects_.data() + tileinfo.collision_offset;
+		for (unsigned int flips = 0; flips < GameMap::NUM_FLIP_VARIANTS; flips++) {
+			GameMap::TileMask mask;
+			for (size_t n = 0; n < tileinfo.collision_count; n++, rect++) {
+				for (int y = std::max(rect->y, 0); y < std::min(rect->y + rect->h, kTileSize); y++) {
+					for (int x = std::max(rect->x, 0); x < std::min(rect->x + rect->w, kTileSize); x++) {
+						mask.rows[y] |= 1 << x;
+						mask.cols[x] |= 1 << y;
+					}
+				}
+			}
+			tile_masks_.emplace_back(mask);
+		}
+	}
+}
+
+static size_t AlignSection(size_t offset) {
+	return (offset + MapFormat::kSectionAlignment - 1) / MapFormat::kSectionAlignment * MapFormat::kSectionAlignment;
+}
+
+template <class T>
+static void PlaceSection(MapFormat::Section& section, const std::vector<T>& data, size_t& offset) {
+	section.offset = offset;
+	section.count = data.size();
+
+	offset = AlignSection(offset + sizeof(T) * data.size());
+}
+
+// Rearranges row-major map into chunks, see MapFormat
+static std::vector<uint32_t> ChunkMapData(const std::vector<uint32_t>& map_data, unsigned int width, unsigned int height) {
+	const unsigned int chunks_x = (width + MapFormat::kChunkSize - 1) / MapFormat::kChunkSize;
+	const unsigned int chunks_y = (height + MapFormat::kChunkSize - 1) / MapFormat::kChunkSize;
+
+	std::vector<uint32_t> chunked((size_t)chunks_x * chunks_y * MapFormat::kChunkTiles, 0);
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++) {
+			size_t chunk = (size_t)(y / MapFormat::kChunkSize) * chunks_x + x / MapFormat::kChunkSize;
+			size_t index = (y % MapFormat::kChunkSize) * MapFormat::kChunkSize + x % MapFormat::kChunkSize;
+			chunked[chunk * MapFormat::kChunkTiles + index] = map_data[(size_t)y * width + x];
+		}
+	}
+
+	return chunked;
+}
+
+template <class T>
+static void StoreSection(std::vector<char>& blob, const MapFormat::Section& section, const std::vector<T>& data) {
+	if (!data.empty())
+		std::memcpy(blob.data() + section.offset, data.data(), sizeof(T) * data.size());
+}
+
+std::vector<char> MapCompiler::GetBlob() const {
+	MapFormat::Header header;
+	std::memset(&header, 0, sizeof(header));
+
+	std::memcpy(header.magic, MapFormat::kMagic, sizeof(header.magic));
+	header.version = MapFormat::kVersion;
+	header.byte_order = MapFormat::kByteOrderMark;
+	header.width = width_;
+	header.height = height_;
+
+	const std::vector<uint32_t> chunked_map_data = ChunkMapData(map_data_, width_, height_);
+
+	size_t offset = AlignSection(sizeof(header));
+	PlaceSection(header.tile_infos, tile_infos_, offset);
+	PlaceSection(header.collision_rects, collision_rects_, offset);
+	PlaceSection(header.tile_masks, tile_masks_, offset);
+
+	// chunks are aligned to their size, see MapFormat
+	offset = (offset + MapFormat::kChunkBytes - 1) / MapFormat::kChunkBytes * MapFormat::kChunkBytes;
+	PlaceSection(header.map_data, chunked_map_data, offset);
+	PlaceSection(header.objects, objects_, offset);
+	PlaceSection(header.metatiles, metatiles_, offset);
+
+	std::vector<char> blob(offset, 0);
+	std::memcpy(blob.data(), &header, sizeof(header));
+
+	StoreSection(blob, header.tile_infos, tile_infos_);
+	StoreSection(blob, header.collision_rects, collision_rects_);
+	StoreSection(blob, header.tile_masks, tile_masks_);
+	StoreSection(blob, header.map_data, chunked_map_data);
+	StoreSection(blob, header.objects, objects_);
+	StoreSection(blob, header.metatiles, metatiles_);
+
+	return blob;
+}
+
+void MapCompiler::Save(const std::string& path) const {
+	std::vector<char> blob = GetBlob();
+
+	// existing map may be mapped by a running game, which must
+	// never see it truncated or half written, so new one is
+	// written aside and renamed over it
+	const std::string temp_path = path + ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("cannot create " + temp_path);
+
+		file.write(blob.data(), blob.size());
+		file.close();
+
+		if (!file) {
+			std::remove(temp_path.c_str());
+			throw std::runtime_error("cannot write " + temp_path);
+		}
+	}
+
+	if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+		std::remove(temp_path.c_str());
+		throw std::runtime_error("cannot rename " + temp_path + " to " + path);
+	}
+}
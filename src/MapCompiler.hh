@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPCOMPILER_HH
+#define MAPCOMPILER_HH
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SDL2pp/Rect.hh>
+
+#include "GameMap.hh"
+#include "MapFormat.hh"
+
+namespace pugi {
+	class xml_node;
+}
+
+// Converts Tiled .tmx map into precompiled binary form used by
+// GameMap, see MapFormat
+class MapCompiler {
+private:
+	struct MetaTileInfo {
+		SDL2pp::Rect source_rect;
+		GameMap::CollisionMap collision_map;
+	};
+
+private:
+	// dense table indexed by global tile id; slot 0 is the empty tile
+	std::vector<GameMap::TileInfo> tile_infos_;
+	std::vector<GameMap::CollisionMap> collision_maps_;
+	std::vector<std::pair<std::string, MetaTileInfo>> metatile_infos_;
+
+	// baked data, stored into blob
+	std::vector<SDL2pp::Rect> collision_rects_;
+	std::vector<GameMap::TileMask> tile_masks_;
+	std::vector<uint32_t> map_data_;
+	unsigned int width_;
+	unsigned int height_;
+
+	std::vector<GameMap::Object> objects_;
+
+	std::vector<MapFormat::MetaTile> metatiles_;
+
+private:
+	void Compile(const pugi::xml_node& map);
+
+public:
+	MapCompiler(const std::string& tmxpath);
+	MapCompiler(const char* tmxdata, size_t size);
+
+	void ParseTileset(const pugi::xml_node& map);
+	void ParseMap(const pugi::xml_node& map);
+	void ParseCsvData(const char* contents);
+	void ParseBase64Data(const char* contents, const char* compression);
+	void ParseObjects(const pugi::xml_node& map);
+
+	void BakeCollisionMaps();
+	void BakeCollisionMasks();
+
+	std::vector<char> GetBlob() const;
+	void Save(const std::string& path) const;
+};
+
+#endif // MAPCOMPILER_HH
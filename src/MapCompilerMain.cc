@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <stdexcept>
+
+#include "MapCompiler.hh"
+
+// Converts .tmx map into precompiled form, which is loaded by
+// the game without any parsing
+
+int main(int argc, char** argv) try {
+	if (argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " input.tmx output.pmap" << std::endl;
+		return 1;
+	}
+
+	MapCompiler(argv[1]).Save(argv[2]);
+
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return 1;
+} catch (...) {
+	std::cerr << "Unknown error" << std::endl;
+	return 1;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPFORMAT_HH
+#define MAPFORMAT_HH
+
+#include <cstdint>
+#include <cstddef>
+
+#include <SDL2pp/Rect.hh>
+
+// Layout of precompiled binary map
+//
+// File starts with Header, followed by sections, each being plain
+// array of structures referenced by offset from the start of file
+// and element count. Data is stored in native byte order and
+// alignment, so file may be used in place after memory mapping.
+// Element types of sections are defined in GameMap.
+//
+// Map tiles are stored in square chunks of kChunkSize tiles, chunks
+// going in row-major order with partial chunks at right and bottom
+// edges padded with empty tiles. Each chunk is a 4 KiB unit aligned
+// to 4 KiB in the file, so on systems with 4 KiB pages parts of a
+// huge map may be paged in and out independently, see MapStreamer;
+// with larger pages, neighbour chunks are paged together.
+namespace MapFormat {
+	constexpr char kMagic[8] = { 'P', 'L', 'N', 'T', 'M', 'A', 'P', '\0' };
+	constexpr uint32_t kVersion = 3;
+	constexpr uint32_t kByteOrderMark = 0x01020304;
+
+	constexpr size_t kSectionAlignment = 16;
+	constexpr size_t kMaxMetaTileName = 32;
+
+	constexpr unsigned int kChunkSize = 32;
+	constexpr unsigned int kChunkTiles = kChunkSize * kChunkSize;
+	constexpr size_t kChunkBytes = kChunkTiles * sizeof(uint32_t);
+
+	struct Section {
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t width;
+		uint32_t height;
+
+		Section tile_infos;      // GameMap::TileInfo, indexed by tile id
+		Section collision_rects; // SDL2pp::Rect
+		Section tile_masks;      // GameMap::TileMask
+		Section map_data;        // uint32_t, chunked, see above
+		Section objects;         // GameMap::Object, sorted by type
+		Section metatiles;       // MapFormat::MetaTile
+	};
+
+	struct MetaTile {
+		char name[kMaxMetaTileName];
+		SDL2pp::Rect source_rect;
+		uint32_t collision_offset;
+		uint32_t collision_count;
+	};
+}
+
+#endif // MAPFORMAT_HH
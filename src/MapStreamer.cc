@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MapStreamer.hh"
+
+#include "Constants.hh"
+#include "GameMap.hh"
+
+// distance to screen boundary at which neighbour screen is prefetched
+static const int kPrefetchMargin = 4 * kTileSize;
+
+static const int kScreenWidth = kScreenWidthTiles * kTileSize;
+static const int kScreenHeight = kScreenHeightTiles * kTileSize;
+static const int kScreenHeightRows = (kScreenHeightPixels + kTileSize - 1) / kTileSize;
+
+MapStreamer::MapStreamer(const GameMap& map, size_t max_resident)
+	: map_(&map),
+	  max_resident_(max_resident) {
+}
+
+void MapStreamer::TouchChunk(unsigned int cx, unsigned int cy) {
+	if (cx >= map_->GetChunksX() || cy >= map_->GetChunksY())
+		return;
+
+	unsigned int chunk = cy * map_->GetChunksX() + cx;
+
+	auto resident = resident_.find(chunk);
+	if (resident != resident_.end()) {
+		lru_.splice(lru_.begin(), lru_, resident->second);
+		return;
+	}
+
+	map_->PrefetchChunk(cx, cy);
+	lru_.push_front(chunk);
+	resident_.emplace(chunk, lru_.begin());
+}
+
+void MapStreamer::TouchScreen(int screen_x, int screen_y) {
+	if (screen_x < 0 || screen_y < 0)
+		return;
+
+	// screens are not chunk aligned, so touch all chunks which
+	// overlap with a screen; note that bottom tile row is partially
+	// visible and belongs to the next screen as well
+	int x_begin = screen_x * kScreenWidthTiles / MapFormat::kChunkSize;
+	int x_end = ((screen_x + 1) * kScreenWidthTiles - 1) / MapFormat::kChunkSize;
+	int y_begin = screen_y * kScreenHeightTiles / MapFormat::kChunkSize;
+	int y_end = (screen_y * kScreenHeightTiles + kScreenHeightRows - 1) / MapFormat::kChunkSize;
+
+	for (int cy = y_begin; cy <= y_end; cy++)
+		for (int cx = x_begin; cx <= x_end; cx++)
+			TouchChunk(cx, cy);
+}
+
+void MapStreamer::Update(const SDL2pp::Point& screen_offset, const SDL2pp::Point& player_anchor) {
+	const int screen_x = screen_offset.x / kScreenWidth;
+	const int screen_y = screen_offset.y / kScreenHeight;
+
+	// prefetch first, so current screen ends up most recently used
+	const SDL2pp::Point local = player_anchor - screen_offset;
+	if (local.x < kPrefetchMargin)
+		TouchScreen(screen_x - 1, screen_y);
+	if (local.x >= kScreenWidth - kPrefetchMargin)
+		TouchScreen(screen_x + 1, screen_y);
+	if (local.y < kPrefetchMargin)
+		TouchScreen(screen_x, screen_y - 1);
+	if (local.y >= kScreenHeight - kPrefetchMargin)
+		TouchScreen(screen_x, screen_y + 1);
+
+	TouchScreen(screen_x, screen_y);
+
+	while (lru_.size() > max_resident_) {
+		unsigned int chunk = lru_.back();
+		map_->EvictChunk(chunk % map_->GetChunksX(), chunk / map_->GetChunksX());
+		resident_.erase(chunk);
+		lru_.pop_back();
+	}
+}
+
+void MapStreamer::SetMap(const GameMap& map) {
+	map_ = &map;
+	lru_.clear();
+	resident_.clear();
+}
+
+size_t MapStreamer::GetResidentChunks() const {
+	return lru_.size();
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPSTREAMER_HH
+#define MAPSTREAMER_HH
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+#include <SDL2pp/Point.hh>
+
+class GameMap;
+
+// Keeps map chunks around the camera paged in, prefetching
+// chunks of the neighbour screen when player approaches its
+// boundary, and evicts least recently used chunks when more
+// than given number of chunks are resident
+class MapStreamer {
+private:
+	const GameMap* map_;
+	size_t max_resident_;
+
+	// chunk indexes, most recently used first
+	std::list<unsigned int> lru_;
+	std::unordered_map<unsigned int, std::list<unsigned int>::iterator> resident_;
+
+private:
+	void TouchScreen(int screen_x, int screen_y);
+	void TouchChunk(unsigned int cx, unsigned int cy);
+
+public:
+	MapStreamer(const GameMap& map, size_t max_resident = 64);
+
+	MapStreamer(const MapStreamer&) = delete;
+	MapStreamer& operator=(const MapStreamer&) = delete;
+
+	// Screen offset and player anchor in pixels, as in GameScene
+	void Update(const SDL2pp::Point& screen_offset, const SDL2pp::Point& player_anchor);
+
+	// Switches to another map, forgetting chunks of the old one
+	void SetMap(const GameMap& map);
+
+	size_t GetResidentChunks() const;
+};
+
+#endif // MAPSTREAMER_HH
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MappedFile.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() {
+}
+
+MappedFile::MappedFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::runtime_error("cannot open " + path);
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		throw std::runtime_error("cannot stat " + path);
+	}
+
+	size_ = st.st_size;
+
+	if (size_ > 0) {
+		void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("cannot map " + path);
+		}
+		data_ = static_cast<const char*>(data);
+	}
+
+	// mapping stays valid after descriptor is closed
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (data_)
+		munmap(const_cast<char*>(data_), size_);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: data_(other.data_),
+	  size_(other.size_) {
+	other.data_ = nullptr;
+	other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (&other == this)
+		return *this;
+
+	if (data_)
+		munmap(const_cast<char*>(data_), size_);
+
+	data_ = other.data_;
+	size_ = other.size_;
+
+	other.data_ = nullptr;
+	other.size_ = 0;
+
+	return *this;
+}
+
+const char* MappedFile::GetData() const {
+	return data_;
+}
+
+size_t MappedFile::GetSize() const {
+	return size_;
+}
+
+static void AdviseRange(const char* data, size_t size, size_t offset, size_t length, int advice) {
+	if (!data || offset >= size)
+		return;
+
+	length = std::min(length, size - offset);
+
+	// madvise needs page aligned address
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t begin = offset / page_size * page_size;
+
+	madvise(const_cast<char*>(data) + begin, offset + length - begin, advice);
+}
+
+void MappedFile::Prefetch(size_t offset, size_t length) const {
+	AdviseRange(data_, size_, offset, length, MADV_WILLNEED);
+}
+
+void MappedFile::Evict(size_t offset, size_t length) const {
+	AdviseRange(data_, size_, offset, length, MADV_DONTNEED);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPEDFILE_HH
+#define MAPPEDFILE_HH
+
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+
+public:
+	MappedFile();
+	MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	const char* GetData() const;
+	size_t GetSize() const;
+
+	// Hint kernel to start reading given range in background, or
+	// to drop its pages, which are then reread on next access.
+	// Both are advisory and never fail
+	void Prefetch(size_t offset, size_t length) const;
+	void Evict(size_t offset, size_t length) const;
+};
+
+#endif // MAPPEDFILE_HH
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ObjectPool.hh"
+
+#include <algorithm>
+
+unsigned int ObjectPool::AddMetaTile(const GameMap::MetaTileInfo& info) {
+	metatiles.push_back(info);
+	return metatiles.size() - 1;
+}
+
+ObjectPool::Index ObjectPool::Add(unsigned int metatile_index, const SDL2pp::Rect& place, float gravity_fraction) {
+	x.push_back(place.x);
+	y.push_back(place.y);
+	xvel.push_back(0.0f);
+	yvel.push_back(0.0f);
+	prev_x.push_back(place.x);
+	prev_y.push_back(place.y);
+	gravity.push_back(gravity_fraction);
+	metatile.push_back(metatile_index);
+	collision.push_back(0);
+
+	return x.size() - 1;
+}
+
+ObjectPool::Index ObjectPool::GetSize() const {
+	return x.size();
+}
+
+void ObjectPool::BeginTick() {
+	std::copy(x.begin(), x.end(), prev_x.begin());
+	std::copy(y.begin(), y.end(), prev_y.begin());
+}
+
+void ObjectPool::ApplyGravity(float delta_velocity) {
+	for (Index index = 0; index < yvel.size(); index++)
+		yvel[index] += gravity[index] * delta_velocity;
+}
+
+ObjectPool::Object ObjectPool::Get(Index index) const {
+	return Object(*this, index);
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECTPOOL_HH
+#define OBJECTPOOL_HH
+
+#include <vector>
+
+#include <SDL2pp/Point.hh>
+#include <SDL2pp/Rect.hh>
+
+#include "GameMap.hh"
+
+// Dynamic objects of a world, stored as structure of arrays
+//
+// Each field of all objects lives in a separate array, so passes
+// which update a field of every object (such as applying gravity)
+// are plain loops over floats which compiler can vectorize, and
+// per-object code only touches fields it needs. Objects are
+// addressed by index and are never removed.
+class ObjectPool {
+public:
+	typedef unsigned int Index;
+
+	// Read-only view of a single object
+	class Object {
+	private:
+		const ObjectPool& pool_;
+		Index index_;
+
+	public:
+		Object(const ObjectPool& pool, Index index)
+			: pool_(pool),
+			  index_(index) {
+		}
+
+		Index GetIndex() const {
+			return index_;
+		}
+
+		float GetX() const {
+			return pool_.x[index_];
+		}
+
+		float GetY() const {
+			return pool_.y[index_];
+		}
+
+		SDL2pp::Point GetPoint() const {
+			return pool_.GetPoint(index_);
+		}
+
+		SDL2pp::Point GetInterpolatedPoint(float alpha) const {
+			return pool_.GetInterpolatedPoint(index_, alpha);
+		}
+
+		SDL2pp::Point GetAnchor() const {
+			return pool_.GetAnchor(index_);
+		}
+
+		SDL2pp::Point GetInterpolatedAnchor(float alpha) const {
+			return pool_.GetInterpolatedAnchor(index_, alpha);
+		}
+
+		const SDL2pp::Rect& GetSrcRect() const {
+			return pool_.GetSrcRect(index_);
+		}
+	};
+
+public:
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> xvel;
+	std::vector<float> yvel;
+
+	// position on previous tick, for render interpolation
+	std::vector<float> prev_x;
+	std::vector<float> prev_y;
+
+	// fraction of gravity applied to the object
+	std::vector<float> gravity;
+
+	// index into metatiles, may change for animation
+	std::vector<unsigned int> metatile;
+
+	// result of last move, GameWorld::CollisionState flags
+	std::vector<int> collision;
+
+	std::vector<GameMap::MetaTileInfo> metatiles;
+
+public:
+	// Registers metatile for use by objects, returns its index
+	unsigned int AddMetaTile(const GameMap::MetaTileInfo& info);
+
+	// Adds object with top left corner at place, returns its index
+	Index Add(unsigned int metatile, const SDL2pp::Rect& place, float gravity);
+
+	Index GetSize() const;
+
+	// Batch passes over all objects
+	void BeginTick();
+	void ApplyGravity(float delta_velocity);
+
+	Object Get(Index index) const;
+
+	const GameMap::MetaTileInfo& GetMetaTile(Index index) const {
+		return metatiles[metatile[index]];
+	}
+
+	SDL2pp::Point GetPoint(Index index) const {
+		return SDL2pp::Point((int)x[index], (int)y[index]);
+	}
+
+	SDL2pp::Point GetInterpolatedPoint(Index index, float alpha) const {
+		return SDL2pp::Point((int)(prev_x[index] + (x[index] - prev_x[index]) * alpha), (int)(prev_y[index] + (y[index] - prev_y[index]) * alpha));
+	}
+
+	SDL2pp::Point GetAnchorOffset(Index index) const {
+		return SDL2pp::Point(GetSrcRect(index).w / 2, GetSrcRect(index).h - 1);
+	}
+
+	SDL2pp::Point GetAnchor(Index index) const {
+		return GetPoint(index) + GetAnchorOffset(index);
+	}
+
+	SDL2pp::Point GetInterpolatedAnchor(Index index, float alpha) const {
+		return GetInterpolatedPoint(index, alpha) + GetAnchorOffset(index);
+	}
+
+	const SDL2pp::Rect& GetSrcRect(Index index) const {
+		return GetMetaTile(index).source_rect;
+	}
+
+	template <class Processor>
+	void ForeachCollisionRect(Index index, Processor processor) const {
+		const SDL2pp::Point point = GetPoint(index);
+		for (const auto& rect : GetMetaTile(index).collision_map)
+			processor(rect + point);
+	}
+};
+
+#endif // OBJECTPOOL_HH
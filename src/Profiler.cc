@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Profiler.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+const size_t Profiler::kHistorySize;
+
+thread_local unsigned int Profiler::counters_[NUM_COUNTERS];
+
+Profiler::ScopedTimer::ScopedTimer(Profiler& profiler, Timer timer)
+	: profiler_(profiler),
+	  timer_(timer),
+	  start_(std::chrono::steady_clock::now()) {
+}
+
+Profiler::ScopedTimer::~ScopedTimer() {
+	profiler_.AddTime(timer_, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start_).count());
+}
+
+Profiler::Profiler()
+	: frame_start_(std::chrono::steady_clock::now()),
+	  history_(kHistorySize * kNumMetrics, 0.0f) {
+}
+
+void Profiler::AddTime(Timer timer, float milliseconds) {
+	frame_times_[timer] += milliseconds;
+}
+
+void Profiler::EndFrame() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	frame_times_[FRAME] = std::chrono::duration<float, std::milli>(now - frame_start_).count();
+	frame_start_ = now;
+
+	float* frame = history_.data() + (num_frames_ % kHistorySize) * kNumMetrics;
+	for (int timer = 0; timer < NUM_TIMERS; timer++)
+		frame[timer] = frame_times_[timer];
+	for (int counter = 0; counter < NUM_COUNTERS; counter++)
+		frame[NUM_TIMERS + counter] = counters_[counter];
+
+	num_frames_++;
+
+	std::fill(std::begin(frame_times_), std::end(frame_times_), 0.0f);
+	std::fill(std::begin(counters_), std::end(counters_), 0);
+}
+
+size_t Profiler::GetNumFrames() const {
+	return std::min(num_frames_, kHistorySize);
+}
+
+float Profiler::GetMetric(int metric, size_t age) const {
+	if (age >= GetNumFrames())
+		return 0.0f;
+
+	return history_[((num_frames_ - 1 - age) % kHistorySize) * kNumMetrics + metric];
+}
+
+Profiler::Stats Profiler::GetMetricStats(int metric) const {
+	std::vector<float> values;
+	for (size_t age = 0; age < GetNumFrames(); age++)
+		values.push_back(GetMetric(metric, age));
+
+	if (values.empty())
+		return Stats{0.0f, 0.0f, 0.0f};
+
+	std::sort(values.begin(), values.end());
+	return Stats{
+		values[values.size() / 2],
+		values[values.size() * 99 / 100],
+		values.back()
+	};
+}
+
+float Profiler::GetTime(Timer timer, size_t age) const {
+	return GetMetric(timer, age);
+}
+
+unsigned int Profiler::GetCount(Counter counter, size_t age) const {
+	return GetMetric(NUM_TIMERS + counter, age);
+}
+
+Profiler::Stats Profiler::GetStats(Timer timer) const {
+	return GetMetricStats(timer);
+}
+
+Profiler::Stats Profiler::GetStats(Counter counter) const {
+	return GetMetricStats(NUM_TIMERS + counter);
+}
+
+const char* Profiler::GetName(Timer timer) {
+	static const char* names[NUM_TIMERS] = { "events", "update", "render", "present", "frame" };
+	return names[timer];
+}
+
+const char* Profiler::GetName(Counter counter) {
+	static const char* names[NUM_COUNTERS] = { "draw_calls", "collision_checks", "move_steps" };
+	return names[counter];
+}
+
+void Profiler::Save(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("cannot create " + path);
+
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) {
+		file << "{\n\t\"frames\": " << num_frames_ << ",\n\t\"history\": " << GetNumFrames();
+		for (int metric = 0; metric < kNumMetrics; metric++) {
+			const char* name = metric < NUM_TIMERS ? GetName((Timer)metric) : GetName((Counter)(metric - NUM_TIMERS));
+			const char* suffix = metric < NUM_TIMERS ? "_ms" : "";
+			Stats stats = GetMetricStats(metric);
+
+			file << ",\n\t\"" << name << suffix << "\": { \"p50\": " << stats.p50 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+		}
+		file << "\n}\n";
+	} else {
+		file << "frame";
+		for (int timer = 0; timer < NUM_TIMERS; timer++)
+			file << "," << GetName((Timer)timer) << "_ms";
+		for (int counter = 0; counter < NUM_COUNTERS; counter++)
+			file << "," << GetName((Counter)counter);
+		file << "\n";
+
+		for (size_t age = GetNumFrames(); age > 0; age--) {
+			file << num_frames_ - age;
+			for (int metric = 0; metric < kNumMetrics; metric++)
+				file << "," << GetMetric(metric, age - 1);
+			file << "\n";
+		}
+	}
+
+	if (!file)
+		throw std::runtime_error("cannot write " + path);
+}
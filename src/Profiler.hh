@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILER_HH
+#define PROFILER_HH
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Per-frame timings of main loop stages and counters of costly
+// operations, kept for a number of recent frames
+class Profiler {
+public:
+	enum Timer {
+		EVENTS,
+		UPDATE,
+		RENDER,
+		PRESENT,
+		FRAME, // whole frame, measured between EndFrame() calls
+
+		NUM_TIMERS
+	};
+
+	enum Counter {
+		DRAW_CALLS,
+		COLLISION_CHECKS,
+		MOVE_STEPS,
+
+		NUM_COUNTERS
+	};
+
+	struct Stats {
+		float p50;
+		float p99;
+		float max;
+	};
+
+	// Adds time spent in its scope to given timer
+	class ScopedTimer {
+	private:
+		Profiler& profiler_;
+		const Timer timer_;
+		const std::chrono::steady_clock::time_point start_;
+
+	public:
+		ScopedTimer(Profiler& profiler, Timer timer);
+		~ScopedTimer();
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+	};
+
+	static const size_t kHistorySize = 1024;
+
+private:
+	static const int kNumMetrics = NUM_TIMERS + NUM_COUNTERS;
+
+	// counters are incremented deep inside game logic, which may
+	// run in several threads (see BatchRunner), so they are kept
+	// per thread and collected by EndFrame() of the thread
+	static thread_local unsigned int counters_[NUM_COUNTERS];
+
+	float frame_times_[NUM_TIMERS] = {};
+	std::chrono::steady_clock::time_point frame_start_;
+
+	// ring buffer of kHistorySize frames by kNumMetrics values,
+	// timers in milliseconds go first
+	std::vector<float> history_;
+	size_t num_frames_ = 0;
+
+private:
+	float GetMetric(int metric, size_t age) const;
+	Stats GetMetricStats(int metric) const;
+
+public:
+	Profiler();
+
+	static void Count(Counter counter, unsigned int amount = 1) {
+		counters_[counter] += amount;
+	}
+
+	void AddTime(Timer timer, float milliseconds);
+
+	// Stores current frame into history and starts a new one
+	void EndFrame();
+
+	// Number of frames available in history
+	size_t GetNumFrames() const;
+
+	// Values for a frame age frames ago, 0 being the last one
+	float GetTime(Timer timer, size_t age) const;
+	unsigned int GetCount(Counter counter, size_t age) const;
+
+	Stats GetStats(Timer timer) const;
+	Stats GetStats(Counter counter) const;
+
+	static const char* GetName(Timer timer);
+	static const char* GetName(Counter counter);
+
+	// Writes per-frame history as CSV, or summary statistics as
+	// JSON if path ends with .json
+	void Save(const std::string& path) const;
+};
+
+#endif // PROFILER_HH
@@ -22,6 +22,8 @@
 SDL2pp::SDL& Scene::GetSDL() const { return application_.sdl_; }
 SDL2pp::Window& Scene::GetWindow() const { return application_.window_; }
 SDL2pp::Renderer& Scene::GetRenderer() const { return application_.renderer_; }
+const Profiler& Scene::GetProfiler() const { return application_.profiler_; }
+AssetCache& Scene::GetAssetCache() const { return application_.asset_cache_; }
 
 void Scene::SetExit(bool exit) {
 	application_.must_exit_ = exit;
@@ -46,10 +48,10 @@ void Scene::ProcessEvent(const SDL_Event& event) {
 	}
 }
 
-void Scene::Update() {
+void Scene::Update(float /*delta_time*/) {
 }
 
-void Scene::Render() {
+void Scene::Render(float /*alpha*/) {
 	GetRenderer().SetDrawColor(0, 0, 0);
 	GetRenderer().Clear();
 }
@@ -36,6 +36,8 @@ protected:
 	SDL2pp::SDL& GetSDL() const;
 	SDL2pp::Window& GetWindow() const;
 	SDL2pp::Renderer& GetRenderer() const;
+	const Profiler& GetProfiler() const;
+	AssetCache& GetAssetCache() const;
 
 	template<class NewScene, class... Args>
 	void SetNextScene(Args&&... args) {
@@ -49,8 +51,14 @@ public:
 	virtual ~Scene();
 
 	virtual void ProcessEvent(const SDL_Event& event);
-	virtual void Update();
-	virtual void Render();
+
+	// Advance scene state by a single fixed tick
+	virtual void Update(float delta_time);
+
+	// Render scene; alpha is the fraction of tick passed since
+	// last update, usable for interpolating between two last
+	// simulation states
+	virtual void Render(float alpha);
 };
 
 #endif // SCENE_HH
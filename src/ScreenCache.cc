@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ScreenCache.hh"
+
+#include <iterator>
+
+#include <SDL2pp/Exception.hh>
+
+ScreenCache::ScreenCache(SDL2pp::Renderer& renderer, int width, int height, size_t capacity)
+	: renderer_(renderer),
+	  width_(width),
+	  height_(height),
+	  capacity_(capacity) {
+}
+
+SDL2pp::Texture& ScreenCache::Get(const SDL2pp::Point& offset, std::function<void()> painter) {
+	for (auto entry = entries_.begin(); entry != entries_.end(); entry++) {
+		if (entry->offset == offset) {
+			entries_.splice(entries_.begin(), entries_, entry);
+			return entries_.front().texture;
+		}
+	}
+
+	// reuse least recently used texture if cache is full
+	if (entries_.size() < capacity_) {
+		entries_.emplace_front(Entry{
+			offset,
+			SDL2pp::Texture(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width_, height_)
+		});
+		entries_.front().texture.SetBlendMode(SDL_BLENDMODE_BLEND);
+	} else {
+		entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+		entries_.front().offset = offset;
+	}
+
+	SDL2pp::Texture& texture = entries_.front().texture;
+
+	// screens are rendered in the middle of a frame, so restore
+	// whatever target was active; SDL2pp can't query it
+	SDL_Texture* previous_target = SDL_GetRenderTarget(renderer_.Get());
+
+	renderer_.SetTarget(texture);
+	renderer_.SetDrawColor(0, 0, 0, 0);
+	renderer_.Clear();
+	painter();
+
+	if (SDL_SetRenderTarget(renderer_.Get(), previous_target) != 0)
+		throw SDL2pp::Exception("SDL_SetRenderTarget");
+
+	return texture;
+}
+
+void ScreenCache::Clear() {
+	entries_.clear();
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCREENCACHE_HH
+#define SCREENCACHE_HH
+
+#include <functional>
+#include <list>
+
+#include <SDL2pp/Point.hh>
+#include <SDL2pp/Renderer.hh>
+#include <SDL2pp/Texture.hh>
+
+// Small LRU cache of screens pre-rendered into native resolution
+// target textures, keyed by screen offset
+class ScreenCache {
+private:
+	struct Entry {
+		SDL2pp::Point offset;
+		SDL2pp::Texture texture;
+	};
+
+private:
+	SDL2pp::Renderer& renderer_;
+
+	const int width_;
+	const int height_;
+	const size_t capacity_;
+
+	// most recently used first
+	std::list<Entry> entries_;
+
+public:
+	ScreenCache(SDL2pp::Renderer& renderer, int width, int height, size_t capacity = 4);
+
+	ScreenCache(const ScreenCache&) = delete;
+	ScreenCache& operator=(const ScreenCache&) = delete;
+
+	// Returns texture for given screen; if it's not cached,
+	// painter is called with the texture set as render target
+	// to draw screen contents
+	SDL2pp::Texture& Get(const SDL2pp::Point& offset, std::function<void()> painter);
+
+	// Drops all cached screens, needed when map changes or
+	// renderer loses contents of target textures
+	void Clear();
+};
+
+#endif // SCREENCACHE_HH
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SnapshotRing.hh"
+
+#include <stdexcept>
+
+// delta is a sequence of (skip, length, bytes...) records, with
+// skip and length LEB128 encoded: skip unchanged bytes, then XOR
+// next length bytes with given ones
+
+// unchanged bytes shorter than this are kept in literal run, as
+// splitting it costs more than it saves
+static const size_t kMinSkip = 4;
+
+static void PutVarint(std::vector<char>& out, size_t value) {
+	do {
+		out.push_back((char)((value & 0x7f) | (value > 0x7f ? 0x80 : 0)));
+		value >>= 7;
+	} while (value);
+}
+
+static size_t GetVarint(const char*& in) {
+	size_t value = 0;
+	for (int shift = 0; ; shift += 7) {
+		const unsigned char byte = *in++;
+		value |= (size_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+}
+
+SnapshotRing::SnapshotRing(size_t capacity, unsigned int key_interval)
+	: capacity_(capacity),
+	  key_interval_(key_interval) {
+	if (capacity_ == 0 || key_interval_ == 0)
+		throw std::runtime_error("snapshot ring capacity and key interval must be positive");
+}
+
+void SnapshotRing::EncodeDelta(const std::vector<char>& from, const std::vector<char>& to, std::vector<char>& delta) {
+	delta.clear();
+
+	const size_t size = to.size();
+	size_t pos = 0;
+	while (pos < size) {
+		const size_t skip_start = pos;
+		while (pos < size && from[pos] == to[pos])
+			pos++;
+
+		if (pos == size)
+			break;
+
+		// literal run ends at a long enough stretch of unchanged bytes
+		const size_t literal_start = pos;
+		size_t literal_end = pos;
+		while (pos < size) {
+			if (from[pos] != to[pos]) {
+				literal_end = ++pos;
+			} else if (pos - literal_end < kMinSkip) {
+				pos++;
+			} else {
+				break;
+			}
+		}
+		pos = literal_end;
+
+		PutVarint(delta, literal_start - skip_start);
+		PutVarint(delta, literal_end - literal_start);
+		for (size_t i = literal_start; i < literal_end; i++)
+			delta.push_back(from[i] ^ to[i]);
+	}
+}
+
+void SnapshotRing::ApplyDelta(std::vector<char>& state, const std::vector<char>& delta) {
+	const char* in = delta.data();
+	const char* end = delta.data() + delta.size();
+
+	char* out = state.data();
+	while (in != end) {
+		out += GetVarint(in);
+		const size_t length = GetVarint(in);
+		for (size_t i = 0; i < length; i++)
+			*out++ ^= *in++;
+	}
+}
+
+void SnapshotRing::Push(const std::vector<char>& state) {
+	Entry entry;
+	if (entries_.empty() || entries_.back().depth + 1 >= key_interval_ || state.size() != newest_.size()) {
+		entry.key = true;
+		entry.depth = 0;
+		entry.data = state;
+	} else {
+		entry.key = false;
+		entry.depth = entries_.back().depth + 1;
+		EncodeDelta(newest_, state, entry.data);
+	}
+
+	entries_.emplace_back(std::move(entry));
+	newest_ = state;
+
+	if (entries_.size() > capacity_) {
+		// oldest snapshot is always a key; next one becomes a key
+		// in its place
+		Entry& next = entries_[1];
+		if (!next.key) {
+			std::vector<char> full = std::move(entries_.front().data);
+			ApplyDelta(full, next.data);
+			next.data = std::move(full);
+			next.key = true;
+		}
+		entries_.pop_front();
+	}
+}
+
+void SnapshotRing::Reconstruct(size_t index, std::vector<char>& state) const {
+	size_t key = index;
+	while (!entries_[key].key)
+		key--;
+
+	state = entries_[key].data;
+	for (size_t i = key + 1; i <= index; i++)
+		ApplyDelta(state, entries_[i].data);
+}
+
+void SnapshotRing::Get(size_t age, std::vector<char>& state) const {
+	if (age >= entries_.size())
+		throw std::runtime_error("snapshot is out of history");
+
+	if (age == 0)
+		state = newest_;
+	else
+		Reconstruct(entries_.size() - 1 - age, state);
+}
+
+void SnapshotRing::DropNewest(size_t count) {
+	if (count >= entries_.size()) {
+		Clear();
+		return;
+	}
+
+	if (count == 0)
+		return;
+
+	entries_.erase(entries_.end() - count, entries_.end());
+	Reconstruct(entries_.size() - 1, newest_);
+}
+
+void SnapshotRing::Clear() {
+	entries_.clear();
+	newest_.clear();
+}
+
+size_t SnapshotRing::GetSize() const {
+	return entries_.size();
+}
+
+bool SnapshotRing::IsEmpty() const {
+	return entries_.empty();
+}
+
+size_t SnapshotRing::GetDataSize() const {
+	size_t size = 0;
+	for (const auto& entry : entries_)
+		size += entry.data.size();
+	return size;
+}
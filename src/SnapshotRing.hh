@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNAPSHOTRING_HH
+#define SNAPSHOTRING_HH
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Bounded history of world states (see GameWorld::SaveState)
+//
+// Snapshots are delta compressed: each is stored as run-length
+// encoded XOR against the previous one, and only every
+// key_interval-th is stored in full, which bounds the number of
+// deltas to apply when reconstructing a snapshot. As consecutive
+// states of a world differ in few bytes, a snapshot usually takes
+// a fraction of its full size. When capacity is exceeded, the
+// oldest snapshot is dropped.
+class SnapshotRing {
+private:
+	struct Entry {
+		bool key;
+		unsigned int depth; // deltas since last key
+		std::vector<char> data; // full state for keys, delta otherwise
+	};
+
+private:
+	const size_t capacity_;
+	const unsigned int key_interval_;
+
+	std::deque<Entry> entries_;
+
+	// full state of the newest snapshot
+	std::vector<char> newest_;
+
+private:
+	static void EncodeDelta(const std::vector<char>& from, const std::vector<char>& to, std::vector<char>& delta);
+	static void ApplyDelta(std::vector<char>& state, const std::vector<char>& delta);
+
+	// Full state of entry at given index
+	void Reconstruct(size_t index, std::vector<char>& state) const;
+
+public:
+	SnapshotRing(size_t capacity, unsigned int key_interval = 32);
+
+	void Push(const std::vector<char>& state);
+
+	// Reconstructs a snapshot, age 0 being the newest one
+	void Get(size_t age, std::vector<char>& state) const;
+
+	// Forgets given number of newest snapshots
+	void DropNewest(size_t count);
+
+	void Clear();
+
+	size_t GetSize() const;
+	bool IsEmpty() const;
+
+	// Bytes taken by stored snapshots
+	size_t GetDataSize() const;
+};
+
+#endif // SNAPSHOTRING_HH
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoftwareRasterizer.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
+#include "GameMap.hh"
+
+// Row copiers; in points to the source pixel which goes to out[0]
+
+static void CopyRow(uint32_t* out, const uint32_t* in, int count) {
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i alpha_mask = _mm_set1_epi32(0xff000000);
+	for (; i + 4 <= count; i += 4) {
+		__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+		__m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(src, alpha_mask), _mm_setzero_si128());
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_and_si128(transparent, dst), _mm_andnot_si128(transparent, src)));
+	}
+#endif
+	for (; i < count; i++)
+		if (in[i] >> 24)
+			out[i] = in[i];
+}
+
+static void CopyRowReversed(uint32_t* out, const uint32_t* in, int count) {
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i alpha_mask = _mm_set1_epi32(0xff000000);
+	for (; i + 4 <= count; i += 4) {
+		__m128i src = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in - i - 3)), _MM_SHUFFLE(0, 1, 2, 3));
+		__m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+		__m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(src, alpha_mask), _mm_setzero_si128());
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_and_si128(transparent, dst), _mm_andnot_si128(transparent, src)));
+	}
+#endif
+	for (; i < count; i++)
+		if (in[-i] >> 24)
+			out[i] = in[-i];
+}
+
+// used for diagonal flips, which read atlas by columns
+static void CopyRowStrided(uint32_t* out, const uint32_t* in, ptrdiff_t stride, int count) {
+	for (int i = 0; i < count; i++, in += stride)
+		if (*in >> 24)
+			out[i] = *in;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height)
+	: width_(width),
+	  height_(height),
+	  pixels_((size_t)width * height, 0) {
+}
+
+void SoftwareRasterizer::SetAtlas(const void* pixels, int width, int height, int pitch) {
+	atlas_width_ = width;
+	atlas_height_ = height;
+	atlas_.resize((size_t)width * height);
+
+	for (int y = 0; y < height; y++)
+		std::memcpy(atlas_.data() + (size_t)y * width, static_cast<const char*>(pixels) + (size_t)y * pitch, width * sizeof(uint32_t));
+}
+
+void SoftwareRasterizer::Clear(uint32_t color) {
+	std::fill(pixels_.begin(), pixels_.end(), color);
+}
+
+void SoftwareRasterizer::Fill(const SDL2pp::Rect& rect, uint32_t color) {
+	const int x_begin = std::max(0, rect.x);
+	const int x_end = std::min(width_, rect.x + rect.w);
+	const int y_begin = std::max(0, rect.y);
+	const int y_end = std::min(height_, rect.y + rect.h);
+
+	for (int y = y_begin; y < y_end; y++)
+		std::fill_n(pixels_.data() + (size_t)y * width_ + x_begin, std::max(x_end - x_begin, 0), color);
+}
+
+void SoftwareRasterizer::Blit(const SDL2pp::Rect& src, const SDL2pp::Point& dst, unsigned int flips) {
+	if (src.x < 0 || src.y < 0 || src.w <= 0 || src.h <= 0 || src.x + src.w > atlas_width_ || src.y + src.h > atlas_height_)
+		return;
+
+	const bool dflip = flips & GameMap::DFLIP;
+	const bool vflip = flips & GameMap::VFLIP;
+	const bool hflip = flips & GameMap::HFLIP;
+
+	// diagonal flip (transposition) is applied first, then
+	// horizontal and vertical ones, same as in tiled
+	const int width = dflip ? src.h : src.w;
+	const int height = dflip ? src.w : src.h;
+
+	// clip to framebuffer
+	const int x_begin = std::max(0, -dst.x);
+	const int x_end = std::min(width, width_ - dst.x);
+	const int y_begin = std::max(0, -dst.y);
+	const int y_end = std::min(height, height_ - dst.y);
+
+	if (x_begin >= x_end || y_begin >= y_end)
+		return;
+
+	const int count = x_end - x_begin;
+	const int first_x = hflip ? width - 1 - x_begin : x_begin;
+
+	for (int y = y_begin; y < y_end; y++) {
+		uint32_t* out = pixels_.data() + (size_t)(dst.y + y) * width_ + dst.x + x_begin;
+		const int row = vflip ? height - 1 - y : y;
+
+		if (dflip) {
+			// output row is atlas column
+			const uint32_t* in = atlas_.data() + (size_t)(src.y + first_x) * atlas_width_ + src.x + row;
+			CopyRowStrided(out, in, hflip ? -atlas_width_ : atlas_width_, count);
+		} else {
+			const uint32_t* in = atlas_.data() + (size_t)(src.y + row) * atlas_width_ + src.x + first_x;
+			if (hflip)
+				CopyRowReversed(out, in, count);
+			else
+				CopyRow(out, in, count);
+		}
+	}
+}
+
+const uint32_t* SoftwareRasterizer::GetPixels() const {
+	return pixels_.data();
+}
+
+int SoftwareRasterizer::GetPitch() const {
+	return width_ * sizeof(uint32_t);
+}
+
+int SoftwareRasterizer::GetWidth() const {
+	return width_;
+}
+
+int SoftwareRasterizer::GetHeight() const {
+	return height_;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTWARERASTERIZER_HH
+#define SOFTWARERASTERIZER_HH
+
+#include <vector>
+#include <cstdint>
+
+#include <SDL2pp/Point.hh>
+#include <SDL2pp/Rect.hh>
+
+// CPU blitter working on 32 bit ARGB pixels, independent of SDL
+// renderer. Source pixels with zero alpha are transparent, all
+// others are opaque, which is enough for paletted pixel art
+class SoftwareRasterizer {
+private:
+	const int width_;
+	const int height_;
+	std::vector<uint32_t> pixels_;
+
+	int atlas_width_ = 0;
+	int atlas_height_ = 0;
+	std::vector<uint32_t> atlas_;
+
+public:
+	SoftwareRasterizer(int width, int height);
+
+	// Copies atlas pixels, pitch is in bytes
+	void SetAtlas(const void* pixels, int width, int height, int pitch);
+
+	void Clear(uint32_t color);
+	void Fill(const SDL2pp::Rect& rect, uint32_t color);
+
+	// Copies src rect of atlas to dst, with a combination of
+	// tiled's flipping flags (GameMap::TileFlips) applied
+	void Blit(const SDL2pp::Rect& src, const SDL2pp::Point& dst, unsigned int flips = 0);
+
+	const uint32_t* GetPixels() const;
+	int GetPitch() const;
+	int GetWidth() const;
+	int GetHeight() const;
+};
+
+#endif // SOFTWARERASTERIZER_HH
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SpatialGrid.hh"
+
+#include <algorithm>
+
+SpatialGrid::SpatialGrid(int width, int height, int cell_size)
+	: cell_size_(cell_size),
+	  columns_(std::max((width + cell_size - 1) / cell_size, 1)),
+	  rows_(std::max((height + cell_size - 1) / cell_size, 1)),
+	  cell_starts_(columns_ * rows_ + 1, 0) {
+}
+
+int SpatialGrid::GetColumn(int x) const {
+	return std::min(std::max(x, 0) / cell_size_, columns_ - 1);
+}
+
+int SpatialGrid::GetRow(int y) const {
+	return std::min(std::max(y, 0) / cell_size_, rows_ - 1);
+}
+
+void SpatialGrid::Fill() {
+	// counting sort of objects by cell: count objects per cell,
+	// convert counts into cell ends and then fill cells from their
+	// ends, which leaves starts of cells in place
+	std::fill(cell_starts_.begin(), cell_starts_.end(), 0);
+	for (unsigned int cell : object_cells_)
+		cell_starts_[cell]++;
+
+	for (size_t cell = 1; cell < cell_starts_.size(); cell++)
+		cell_starts_[cell] += cell_starts_[cell - 1];
+
+	objects_.resize(object_cells_.size());
+	for (unsigned int index = object_cells_.size(); index > 0; index--)
+		objects_[--cell_starts_[object_cells_[index - 1]]] = index - 1;
+}
+
+int SpatialGrid::GetCellSize() const {
+	return cell_size_;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPATIALGRID_HH
+#define SPATIALGRID_HH
+
+#include <algorithm>
+#include <vector>
+
+#include <SDL2pp/Point.hh>
+#include <SDL2pp/Rect.hh>
+
+// Uniform grid broadphase for finding objects near given area
+//
+// Objects are identified by index and bucketed by their top left
+// corner, so queries extend one cell up and left, which requires
+// objects not to be larger than a cell. Grid is rebuilt from
+// scratch when objects move, which is linear in their number.
+// Objects and queries outside of the grid are clamped to its
+// edge cells.
+class SpatialGrid {
+private:
+	int cell_size_;
+	int columns_;
+	int rows_;
+
+	// indexes of objects in cell n are
+	// objects_[cell_starts_[n]..cell_starts_[n + 1])
+	std::vector<unsigned int> cell_starts_;
+	std::vector<unsigned int> objects_;
+
+	// scratch space for Build()
+	std::vector<unsigned int> object_cells_;
+
+private:
+	int GetColumn(int x) const;
+	int GetRow(int y) const;
+
+	void Fill();
+
+public:
+	// Size of area covered, in pixels
+	SpatialGrid(int width, int height, int cell_size);
+
+	// Rebuilds grid for count objects; position(index) returns
+	// top left corner of an object
+	template <class PositionGetter>
+	void Build(unsigned int count, PositionGetter position) {
+		object_cells_.resize(count);
+		for (unsigned int index = 0; index < count; index++) {
+			const SDL2pp::Point point = position(index);
+			object_cells_[index] = GetRow(point.y) * columns_ + GetColumn(point.x);
+		}
+
+		Fill();
+	}
+
+	// Calls processor(index) for each object which may intersect
+	// with rect; exact check is up to the caller
+	template <class Processor>
+	void Query(const SDL2pp::Rect& rect, Processor processor) const {
+		if (rect.w <= 0 || rect.h <= 0)
+			return;
+
+		const int first_column = std::max(GetColumn(rect.x) - 1, 0);
+		const int last_column = GetColumn(rect.x + rect.w - 1);
+		const int first_row = std::max(GetRow(rect.y) - 1, 0);
+		const int last_row = GetRow(rect.y + rect.h - 1);
+
+		for (int row = first_row; row <= last_row; row++) {
+			const unsigned int* cells = cell_starts_.data() + row * columns_;
+			for (unsigned int i = cells[first_column]; i < cells[last_column + 1]; i++)
+				processor(objects_[i]);
+		}
+	}
+
+	int GetCellSize() const;
+};
+
+#endif // SPATIALGRID_HH
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2015 Dmitry Marakasov
+ *
+ * This file is part of planetonomy.
+ *
+ * planetonomy is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * planetonomy is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with planetonomy.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks that switching a world to a map it can't use (such as one
+// missing the player) throws and leaves the world as it was
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "GameMap.hh"
+#include "GameWorld.hh"
+
+static const float kDeltaTime = 0.01f;
+
+static void Run(GameWorld& world, unsigned int ticks) {
+	world.SetControlFlags((int)GameWorld::ControlFlags::RIGHT);
+	for (unsigned int tick = 0; tick < ticks; tick++)
+		world.Update(kDeltaTime);
+}
+
+int main(int argc, char** argv) try {
+	if (argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " map broken_map" << std::endl;
+		return 1;
+	}
+
+	const GameMap map(argv[1]);
+	const GameMap broken_map(argv[2]);
+
+	// reference world never sees a reload
+	GameWorld world(map);
+	GameWorld reference(map);
+	Run(world, 200);
+	Run(reference, 200);
+
+	std::vector<char> before, after;
+	world.SaveState(before);
+
+	try {
+		world.SetMap(broken_map);
+		std::cerr << "FAIL: switching to broken map did not throw" << std::endl;
+		return 1;
+	} catch (std::runtime_error& e) {
+		std::cerr << "switching to broken map failed as expected: " << e.what() << std::endl;
+	}
+
+	world.SaveState(after);
+	if (after != before || &world.GetMap() != &map) {
+		std::cerr << "FAIL: world changed by failed switch" << std::endl;
+		return 1;
+	}
+
+	// world must still be simulated exactly as before
+	Run(world, 200);
+	Run(reference, 200);
+	if (world.GetStateHash() != reference.GetStateHash()) {
+		std::cerr << "FAIL: world diverged after failed switch" << std::endl;
+		return 1;
+	}
+
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << "Error: " << e.what() << std::endl;
+	return 1;
+}